@@ -21,18 +21,119 @@
 
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 #include "ebu_r128_proc.h"
+#include "../jmeters/jmeterkernel.h"
 
 namespace LV2M {
 
-float Ebu_r128_hist::_bin_power [100] = { 0.0f };
-float Ebu_r128_proc::_chan_gain [5] = { 1.0f, 1.0f, 1.0f, 1.41f, 1.41f };
+double Ebu_r128_hist::_bin_power [EBU_HIST_N] = { 0.0 };
+static pthread_once_t bin_power_once = PTHREAD_ONCE_INIT;
+
+// BS.1770-4: 1.41 for channels below 30 degrees elevation and between
+// 60 and 120 degrees azimuth, 0 for LFE, 1 for all others. Mono is
+// counted twice, as if played on both loudspeakers of a stereo pair.
+const float Ebu_r128_proc::_layout_gain [6][MAXCH] =
+{
+    { 2.0f },                                                       // MONO
+    { 1.0f, 1.0f },                                                 // STEREO
+    { 1.0f, 1.0f, 1.0f, 1.41f, 1.41f },                             // SURR_5_0
+    { 1.0f, 1.0f, 1.0f, 0.0f, 1.41f, 1.41f },                       // SURR_5_1
+    { 1.0f, 1.0f, 1.0f, 0.0f, 1.41f, 1.41f, 1.0f, 1.0f },           // SURR_7_1
+    { 1.0f, 1.0f, 1.0f, 0.0f, 1.41f, 1.41f, 1.0f, 1.0f,
+      1.0f, 1.0f, 1.0f, 1.0f }                                      // SURR_7_1_4
+};
+
+
+void Ebu_r128_fst::reset (void)
+{
+    memset (_z1, 0, sizeof (_z1));
+    memset (_z2, 0, sizeof (_z2));
+    memset (_z3, 0, sizeof (_z3));
+    memset (_z4, 0, sizeof (_z4));
+}
+
+
+// K-weighting of L::N channels, one per lane. Per lane this is the
+// same arithmetic as the former per-channel loop.
+
+template <class L>
+struct Ebu_r128_kernel
+{
+    typedef typename L::V V;
+
+    Ebu_r128_kernel (const float *c, const float *z1, const float *z2, const float *z3, const float *z4) :
+	_a0 (L::set1 (c [0])), _a1 (L::set1 (c [1])), _a2 (L::set1 (c [2])),
+	_b1 (L::set1 (c [3])), _b2 (L::set1 (c [4])),
+	_c3 (L::set1 (c [5])), _c4 (L::set1 (c [6])),
+	_z1 (L::load (z1)), _z2 (L::load (z2)), _z3 (L::load (z3)), _z4 (L::load (z4)),
+	_s (L::set1 (0)) {}
+
+    inline void step (V x)
+    {
+	V y;
+
+	x = L::sub (L::sub (x, L::mul (_b1, _z1)), L::mul (_b2, _z2));
+	y = L::add (L::add (L::mul (_a0, x), L::mul (_a1, _z1)), L::mul (_a2, _z2));
+	y = L::sub (L::sub (y, L::mul (_c3, _z3)), L::mul (_c4, _z4));
+	_z2 = _z1;
+	_z1 = x;
+	_z4 = L::add (_z4, _z3);
+	_z3 = L::add (_z3, y);
+	_s  = L::add (_s, L::mul (y, y));
+    }
+
+    const V _a0, _a1, _a2, _b1, _b2, _c3, _c4;
+    V _z1, _z2, _z3, _z4, _s;
+};
+
+
+template <class L, class S>
+static float ebu_r128_group (const S &src, int n, const float *c, const float *g,
+			     float *z1, float *z2, float *z3, float *z4)
+{
+    typename L::V x0, x1, x2, x3;
+    Ebu_r128_kernel <L> k (c, z1, z2, z3, z4);
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4)
+    {
+	src.get4 (j, x0, x1, x2, x3);
+	k.step (x0);
+	k.step (x1);
+	k.step (x2);
+	k.step (x3);
+    }
+    for (; j < n; j++) k.step (src.get1 (j));
+    L::store (z1, k._z1);
+    L::store (z2, k._z2);
+    L::store (z3, k._z3);
+    L::store (z4, k._z4);
+    return L::sum (L::mul (L::load (g), k._s));
+}
+
+
+template <class L>
+static float ebu_r128_lanes (float * const *p, float * const *q, int nact, int n, const float *c,
+			     const float *g, float *z1, float *z2, float *z3, float *z4)
+{
+    float s = 0;
+
+    for (int i = 0; i < nact; i += L::N)
+    {
+	if (q) s += ebu_r128_group <L> (SrcLanesCopy <L> (p + i, q + i, n), n, c, g + i, z1 + i, z2 + i, z3 + i, z4 + i);
+	else   s += ebu_r128_group <L> (SrcLanes <L> (p + i), n, c, g + i, z1 + i, z2 + i, z3 + i, z4 + i);
+    }
+    return s;
+}
 
 
 Ebu_r128_hist::Ebu_r128_hist (void)
 {
-    _histc = new int [751];
-    initstat ();
+    _histc = new int [EBU_HIST_N];
+    _ftcnt = new int [EBU_HIST_N + 1];
+    _ftpwr = new double [EBU_HIST_N + 1];
+    pthread_once (&bin_power_once, initstat);
     reset ();
 }
 
@@ -40,12 +141,16 @@ Ebu_r128_hist::Ebu_r128_hist (void)
 Ebu_r128_hist::~Ebu_r128_hist (void)
 {
     delete[] _histc;
+    delete[] _ftcnt;
+    delete[] _ftpwr;
 }
 
 
 void Ebu_r128_hist::reset (void)
 {
-    memset (_histc, 0, 751 * sizeof (float));
+    memset (_histc, 0, EBU_HIST_N * sizeof (int));
+    memset (_ftcnt, 0, (EBU_HIST_N + 1) * sizeof (int));
+    memset (_ftpwr, 0, (EBU_HIST_N + 1) * sizeof (double));
     _count = 0;
     _error = 0;
 }
@@ -55,17 +160,18 @@ void Ebu_r128_hist::initstat (void)
 {
     int i;
 
-    if (_bin_power [0]) return;
-    for (i = 0; i < 100; i++)
+    // Power of each bin relative to 0 LUFS (bin 700).
+    for (i = 0; i < EBU_HIST_N; i++)
     {
-	_bin_power [i] = powf (10.0f, i / 100.0f);
+	_bin_power [i] = pow (10.0, (i - 700) / 100.0);
     }
 }
 
 
 void Ebu_r128_hist::addpoint (float v)
 {
-    int k;
+    int    i, k;
+    double p;
 
     k = (int) floorf (10 * v + 700.5f);
     if (k < 0) return;
@@ -76,28 +182,73 @@ void Ebu_r128_hist::addpoint (float v)
     }
     _histc [k]++;
     _count++;
+    p = _bin_power [k];
+    for (i = k + 1; i <= EBU_HIST_N; i += i & -i)
+    {
+	_ftcnt [i]++;
+	_ftpwr [i] += p;
+    }
 }
 
 
-float Ebu_r128_hist::integrate (int i)
+int Ebu_r128_hist::count_below (int k)
 {
-    int   j, k, n;
-    float s;
+    // Number of points in bins 0 .. k-1.
+    int n;
 
-    j = i % 100;
-    n = 0;
-    s = 0;
-    while (i <= 750)
+    for (n = 0; k > 0; k -= k & -k) n += _ftcnt [k];
+    return n;
+}
+
+
+int Ebu_r128_hist::find_count (int cnt)
+{
+    // Largest bin index k such that count_below (k + 1) <= cnt,
+    // or -1 if the first bin alone holds more than cnt points.
+    int i, m;
+
+    for (i = 0, m = 512; m; m >>= 1)
     {
-	k = _histc [i++];
-	n += k;
-	s += k * _bin_power [j++];
-	if (j == 100)
+	if (i + m <= EBU_HIST_N && _ftcnt [i + m] <= cnt)
 	{
-	    j = 0;
-	    s /= 10.0f;
+	    i += m;
+	    cnt -= _ftcnt [i];
 	}
-    }	
+    }
+    return i - 1;
+}
+
+
+void Ebu_r128_hist::merge (const Ebu_r128_hist *H)
+{
+    // Fenwick trees are linear, they are added node by node.
+    int i;
+
+    for (i = 0; i < EBU_HIST_N; i++) _histc [i] += H->_histc [i];
+    for (i = 1; i <= EBU_HIST_N; i++)
+    {
+	_ftcnt [i] += H->_ftcnt [i];
+	_ftpwr [i] += H->_ftpwr [i];
+    }
+    _count += H->_count;
+    _error += H->_error;
+}
+
+
+float Ebu_r128_hist::integrate (int i)
+{
+    // Mean power of the points in bins i .. 750.
+    int    k, n;
+    double s;
+
+    n = _count;
+    s = 0;
+    for (k = EBU_HIST_N; k > 0; k -= k & -k) s += _ftpwr [k];
+    for (k = i; k > 0; k -= k & -k)
+    {
+	n -= _ftcnt [k];
+	s -= _ftpwr [k];
+    }
     return s / n;
 }
 
@@ -127,7 +278,7 @@ void Ebu_r128_hist::calc_integ (float *vi, float *th)
 
 void Ebu_r128_hist::calc_range (float *v0, float *v1, float *th)
 {
-    int   i, j, k, n;
+    int   i, j, k, n, m;
     float a, b, s;
 
     if (_count < 20)
@@ -140,11 +291,14 @@ void Ebu_r128_hist::calc_range (float *v0, float *v1, float *th)
     if (th) *th = 10 * log10f (s) - 20.0f;
     k = (int)(floorf (100 * log10f (s) + 0.5)) + 500;
     if (k < 0) k = 0;
-    for (i = k, n = 0; i <= 750; i++) n += _histc [i]; 
+    m = count_below (k);
+    n = _count - m;
     a = 0.10f * n;
     b = 0.95f * n;
-    for (i =   k, s = 0; s < a; i++) s += _histc [i];
-    for (j = 750, s = n; s > b; j--) s -= _histc [j];
+    // i - 1 is the first bin where the count from k reaches a,
+    // j the last one where it does not exceed b.
+    i = (n > 0) ? find_count (m + (int) ceilf (a) - 1) + 2 : k;
+    j = find_count (m + (int) floorf (b));
     *v0 = (i - 701) / 10.0f;
     *v1 = (j - 699) / 10.0f;
 }
@@ -152,7 +306,16 @@ void Ebu_r128_hist::calc_range (float *v0, float *v1, float *th)
 
 
 
-Ebu_r128_proc::Ebu_r128_proc (void)
+Ebu_r128_proc::Ebu_r128_proc (void) :
+    _nchan (0),
+    _fsamp (0),
+    _fragm (0),
+    _hop (EBU_HOP),
+    _nfr_M (8),
+    _nfr_S (60),
+    _per_M (2),
+    _per_S (10),
+    _alias (false)
 {
     reset ();
 }
@@ -165,11 +328,68 @@ Ebu_r128_proc::~Ebu_r128_proc (void)
 
 void Ebu_r128_proc::init (int nchan, float fsamp)
 {
+    int i;
+
+    if (nchan > MAXCH) nchan = MAXCH;
+    switch (nchan)
+    {
+    case 1:  init (MONO, fsamp); return;
+    case 2:  init (STEREO, fsamp); return;
+    case 5:  init (SURR_5_0, fsamp); return;
+    }
+    // Layouts of the legacy 3 and 4 channel modes continue the 5.0
+    // order, anything wider is unweighted.
+    for (i = 0; i < MAXCH; i++)
+    {
+	_chan_gain [i] = (nchan < 5) ? _layout_gain [SURR_5_0][i] : 1.0f;
+    }
     _nchan = nchan;
     _fsamp = fsamp;
-    _fragm = (int) fsamp / 20;
     detect_init (_fsamp);
+    if (set_hop (_hop)) set_hop (EBU_HOP);
+}
+
+
+void Ebu_r128_proc::init (Layout layout, float fsamp)
+{
+    memcpy (_chan_gain, _layout_gain [layout], sizeof (_chan_gain));
+    _nchan = layout_nchan (layout);
+    _fsamp = fsamp;
+    detect_init (_fsamp);
+    if (set_hop (_hop)) set_hop (EBU_HOP);
+}
+
+
+int Ebu_r128_proc::set_hop (int msec)
+{
+    // The hop must divide the 100 ms gating block step, and thus
+    // also the 400 ms and 3 s windows. Fragments of a truncated
+    // length would drift from that grid.
+    if (msec < EBU_MINHOP || 100 % msec) return 1;
+    if (msec != EBU_HOP && fmod ((double) _fsamp * msec, 1000.0) != 0) return 1;
+    _hop = msec;
+    _fragm = (int)(_fsamp * msec / 1000);
+    _nfr_M = 400 / msec;
+    _nfr_S = 3000 / msec;
+    _per_M = 100 / msec;
+    _per_S = 500 / msec;
     reset ();
+    return 0;
+}
+
+
+int Ebu_r128_proc::layout_nchan (Layout layout)
+{
+    switch (layout)
+    {
+    case MONO:       return 1;
+    case STEREO:     return 2;
+    case SURR_5_0:   return 5;
+    case SURR_5_1:   return 6;
+    case SURR_7_1:   return 8;
+    case SURR_7_1_4: return 12;
+    }
+    return 0;
 }
 
 
@@ -183,7 +403,11 @@ void Ebu_r128_proc::reset (void)
     _div2 = 0;
     _loudness_M = -200.0f;
     _loudness_S = -200.0f;
-    memset (_power, 0, 64 * sizeof (float));
+    memset (_power, 0, EBU_NFRAG * sizeof (float));
+    _sum_M = 0;
+    _sum_S = 0;
+    _nsum = 0;
+    _nfill = 0;
     integr_reset ();
     detect_reset ();
 }
@@ -204,11 +428,59 @@ void Ebu_r128_proc::integr_reset (void)
 }
 
 
-void Ebu_r128_proc::process (int nfram, float *input [])
+void Ebu_r128_proc::integr_update (void)
+{
+    _hist_M.calc_integ (&_integrated, &_integ_thr);
+    _hist_S.calc_range (&_range_min, &_range_max, &_range_thr);
+}
+
+
+void Ebu_r128_proc::integr_merge (const Ebu_r128_proc &P)
+{
+    _hist_M.merge (&P._hist_M);
+    _hist_S.merge (&P._hist_S);
+    if (P._maxloudn_M > _maxloudn_M) _maxloudn_M = P._maxloudn_M;
+    if (P._maxloudn_S > _maxloudn_S) _maxloudn_S = P._maxloudn_S;
+    integr_update ();
+}
+
+
+void Ebu_r128_proc::process (int nfram, float *input [], float *output [])
 {
     int  i, k;
     
-    for (i = 0; i < _nchan; i++) _ipp [i] = input [i];
+    // If output is given, channels that are not processed in-place
+    // are copied by the filter loop.
+    for (i = 0; i < _nchan; i++)
+    {
+	_ipp [i] = input [i];
+	_opp [i] = (output && output [i] != input [i]) ? output [i] : 0;
+    }
+    // A host may pass the input of one channel as the output of
+    // another. Then nothing is copied before it has been filtered.
+    _alias = false;
+    for (i = 0; i < _nchan; i++)
+    {
+	if (!_opp [i]) continue;
+	for (k = 0; k < _nchan; k++)
+	{
+	    if (_opp [i] < input [k] + nfram && input [k] < _opp [i] + nfram) _alias = true;
+	}
+    }
+    // Channels with non-zero gain go to the filter lanes, padding
+    // lanes repeat the last one with zero gain.
+    for (i = k = 0; i < _nchan; i++)
+    {
+	if (_chan_gain [i] == 0) continue;
+	_lchan [k] = i;
+	_lgain [k++] = _chan_gain [i];
+    }
+    _nact = k;
+    for (; k < EBU_NLANE; k++)
+    {
+	_lchan [k] = _nact ? _lchan [_nact - 1] : 0;
+	_lgain [k] = 0;
+    }
     while (nfram)
     {
 	k = (_frcnt < nfram) ? _frcnt : nfram;
@@ -216,47 +488,65 @@ void Ebu_r128_proc::process (int nfram, float *input [])
         _frcnt -= k;
 	if (_frcnt == 0)
 	{
-	    _power [_wrind++] = _frpwr / _fragm;
+	    addfrag (_frpwr / _fragm);
 	    _frcnt = _fragm;
 	    _frpwr = 1e-30f;
-	    _wrind &= 63;
-	    _loudness_M = addfrags (8);
-	    _loudness_S = addfrags (60);
+	    if (_nfill < _nfr_S) _nfill++;
+	    _loudness_M = -0.6976f + 10 * log10f (_sum_M / _nfr_M);
+	    _loudness_S = -0.6976f + 10 * log10f (_sum_S / _nfr_S);
 	    if (!isfinite(_loudness_M) || _loudness_M < -200.f) _loudness_M = -200.0f;
 	    if (!isfinite(_loudness_S) || _loudness_S < -200.f) _loudness_S = -200.0f;
             if (_loudness_M > _maxloudn_M) _maxloudn_M = _loudness_M;
             if (_loudness_S > _maxloudn_S) _maxloudn_S = _loudness_S;
 	    if (_integr)
 	    {
-	        if (++_div1 == 2)
+	        // Only complete windows count, not those that still
+	        // include the silence before the first fragment.
+	        if (++_div1 == _per_M)
   	        {
-		    _hist_M.addpoint (_loudness_M);
+		    if (_nfill >= _nfr_M) _hist_M.addpoint (_loudness_M);
 		    _div1 = 0;
 	        }
-	        if (++_div2 == 10)
+	        if (++_div2 == _per_S)
 	        {
-		    _hist_S.addpoint (_loudness_S);
+		    if (_nfill >= _nfr_S) _hist_S.addpoint (_loudness_S);
 		    _div2 = 0;
-		    _hist_M.calc_integ (&_integrated, &_integ_thr);
-		    _hist_S.calc_range (&_range_min, &_range_max, &_range_thr);
+		    integr_update ();
 		}
 	    }
 	}
-	for (i = 0; i < _nchan; i++) _ipp [i] += k;
+	for (i = 0; i < _nchan; i++)
+	{
+	    _ipp [i] += k;
+	    if (_opp [i]) _opp [i] += k;
+	}
 	nfram -= k;
     }
 }
 
 
-float Ebu_r128_proc::addfrags (int nfrag)
+void Ebu_r128_proc::addfrag (float p)
 {
-    int    i, k;
-    float  s;
+    int  i, k;
 
-    s = 0;
-    k = (_wrind - nfrag) & 63;
-    for (i = 0; i < nfrag; i++) s += _power [(i + k) & 63];
-    return -0.6976f + 10 * log10f (s / nfrag);
+    // Running sums over the M and S windows: add the new fragment,
+    // subtract the one that leaves the window. They are summed again
+    // once per S window, or if they are no longer finite, so that
+    // rounding errors do not accumulate.
+    _sum_M += p - _power [(_wrind - _nfr_M) & (EBU_NFRAG - 1)];
+    _sum_S += p - _power [(_wrind - _nfr_S) & (EBU_NFRAG - 1)];
+    _power [_wrind] = p;
+    _wrind = (_wrind + 1) & (EBU_NFRAG - 1);
+    if (++_nsum < _nfr_S && isfinite (_sum_S) && isfinite (_sum_M)) return;
+    _nsum = 0;
+    _sum_M = 0;
+    _sum_S = 0;
+    for (i = 1; i <= _nfr_S; i++)
+    {
+	k = (_wrind - i) & (EBU_NFRAG - 1);
+	if (i <= _nfr_M) _sum_M += _power [k];
+	_sum_S += _power [k];
+    }
 }
 
 
@@ -295,45 +585,101 @@ void Ebu_r128_proc::detect_init (float fsamp)
 
 void Ebu_r128_proc::detect_reset (void)
 {
-    for (int i = 0; i < MAXCH; i++) _fst [i].reset ();
+    _fst.reset ();
 }
 
 
 float Ebu_r128_proc::detect_process (int nfram)
 {
-    int   i, j;
-    float si, sj;
-    float x, y, z1, z2, z3, z4;
-    float *p;
-    Ebu_r128_fst *S;
-
-    si = 0;
-    for (i = 0, S = _fst; i < _nchan; i++, S++)
+    int   i, j, c;
+    bool  fused;
+    float si;
+    float c7 [7];
+    float *pp [EBU_NLANE];
+    float *qq [EBU_NLANE];
+    float z1 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float z2 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float z3 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float z4 [EBU_NLANE] __attribute__ ((aligned (32)));
+
+    // The pass-through copy is fused with the filter input if every
+    // filtered channel has an output, else it is a separate pass.
+    // Excluded channels (LFE) are only copied. If outputs alias
+    // inputs, all are copied by detect_copy() after filtering.
+    fused = !_alias;
+    for (i = 0; i < _nact; i++) if (!_opp [_lchan [i]]) fused = false;
+    if (!_alias)
     {
-	z1 = S->_z1;
-	z2 = S->_z2;
-	z3 = S->_z3;
-	z4 = S->_z4;
-	p = _ipp [i];
-	sj = 0;
-	for (j = 0; j < nfram; j++)
+	for (i = 0; i < _nchan; i++)
 	{
-	    x = p [j] - _b1 * z1 - _b2 * z2 + 1e-15f;
-	    y = _a0 * x + _a1 * z1 + _a2 * z2 - _c3 * z3 - _c4 * z4;
-	    z2 = z1;
-	    z1 = x;
-	    z4 += z3;
-	    z3 += y;
-	    sj += y * y;
+	    if (_opp [i] && (!fused || _chan_gain [i] == 0)) jmeter_copy (_ipp [i], _opp [i], nfram);
 	}
-	if (_nchan == 1) si = 2 * sj;
-	else si += _chan_gain [i] * sj;
-	S->_z1 = !isfinite(z1) ? 0 : z1;
-	S->_z2 = !isfinite(z2) ? 0 : z2;
-	S->_z3 = !isfinite(z3) ? 0 : z3;
-	S->_z4 = !isfinite(z4) ? 0 : z4;
     }
+    if (!_nact)
+    {
+	if (_alias) detect_copy (nfram);
+	return 0;
+    }
+
+    for (j = 0; j < EBU_NLANE; j++)
+    {
+	c = _lchan [j];
+	pp [j] = _ipp [c];
+	qq [j] = _opp [c];
+	z1 [j] = _fst._z1 [c];
+	z2 [j] = _fst._z2 [c];
+	z3 [j] = _fst._z3 [c];
+	z4 [j] = _fst._z4 [c];
+    }
+    c7 [0] = _a0;
+    c7 [1] = _a1;
+    c7 [2] = _a2;
+    c7 [3] = _b1;
+    c7 [4] = _b2;
+    c7 [5] = _c3;
+    c7 [6] = _c4;
+
+#ifdef __AVX__
+    if (_nact > 4) si = ebu_r128_lanes <LaneAVX> (pp, fused ? qq : 0, _nact, nfram, c7, _lgain, z1, z2, z3, z4);
+    else
+#endif
+#ifdef __SSE__
+    if (_nact > 1) si = ebu_r128_lanes <LaneSSE> (pp, fused ? qq : 0, _nact, nfram, c7, _lgain, z1, z2, z3, z4);
+    else
+#endif
+    si = ebu_r128_lanes <LaneFlt> (pp, fused ? qq : 0, _nact, nfram, c7, _lgain, z1, z2, z3, z4);
+
+    for (j = 0; j < _nact; j++)
+    {
+	c = _lchan [j];
+	_fst._z1 [c] = !isfinite(z1 [j]) ? 0 : z1 [j];
+	_fst._z2 [c] = !isfinite(z2 [j]) ? 0 : z2 [j];
+	_fst._z3 [c] = !isfinite(z3 [j]) ? 0 : z3 [j];
+	_fst._z4 [c] = !isfinite(z4 [j]) ? 0 : z4 [j];
+    }
+    if (_alias) detect_copy (nfram);
     return si;
 }
 
+
+void Ebu_r128_proc::detect_copy (int nfram)
+{
+    int   i, j, k;
+    float t [MAXCH][64];
+
+    // All inputs of a block are read before any output is written.
+    for (j = 0; j < nfram; j += k)
+    {
+	k = (nfram - j < 64) ? nfram - j : 64;
+	for (i = 0; i < _nchan; i++)
+	{
+	    if (_opp [i]) memcpy (t [i], _ipp [i] + j, k * sizeof (float));
+	}
+	for (i = 0; i < _nchan; i++)
+	{
+	    if (_opp [i]) memcpy (_opp [i] + j, t [i], k * sizeof (float));
+	}
+    }
+}
+
 }
@@ -23,22 +23,40 @@
 #define __EBU_R128_PROC_H
 
 
-#define MAXCH 5
+#define MAXCH 12                   // 7.1.4
+#define EBU_NLANE 16               // MAXCH rounded up to a multiple of 8 (AVX)
+#define EBU_MINHOP 5               // Shortest hop, ms.
+#define EBU_HOP    50              // Default hop, ms.
+#define EBU_NFRAG 1024             // Power ring size, > 3 s / EBU_MINHOP.
 
 namespace LV2M {
 
+// K-weighting filter states of all channels, one array per state
+// variable (structure of arrays), channel i in element i. The filter
+// runs on up to 8 channels per instruction, see detect_process().
+
 class Ebu_r128_fst
 {
 private:
 
     friend class Ebu_r128_proc;
 
-    void reset (void) { _z1 = _z2 = _z3 = _z4 = 0; }
+    void reset (void);
 
-    float _z1, _z2, _z3, _z4;
+    float _z1 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float _z2 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float _z3 [EBU_NLANE] __attribute__ ((aligned (32)));
+    float _z4 [EBU_NLANE] __attribute__ ((aligned (32)));
 };
 
 
+// Loudness histogram, 751 bins of 0.1 LU from -70 to +5 LUFS.
+// Counts and powers are also kept in Fenwick (binary indexed) trees,
+// so that adding a point, the gated integral and the percentiles
+// of the loudness range are O(log N) instead of a scan of all bins.
+
+#define EBU_HIST_N 751
+
 class Ebu_r128_hist
 {
 private:
@@ -49,17 +67,22 @@ private:
     friend class Ebu_r128_proc;
 
     void  reset (void);
-    void  initstat (void);
+    static void initstat (void);
     void  addpoint (float v);
     float integrate (int ind);
     void  calc_integ (float *vi, float *th);
     void  calc_range (float *v0, float *v1, float *th);
+    int   count_below (int ind);
+    int   find_count (int cnt);
+    void  merge (const Ebu_r128_hist *H);
 
-    int  *_histc;
-    int   _count;
-    int   _error;
+    int    *_histc;
+    int    *_ftcnt;   // Fenwick tree of _histc, 1-based.
+    double *_ftpwr;   // Fenwick tree of _histc [i] * _bin_power [i].
+    int     _count;
+    int     _error;
 
-    static float _bin_power [100];
+    static double _bin_power [EBU_HIST_N];
 };
 
 
@@ -68,15 +91,48 @@ class Ebu_r128_proc
 {
 public:
 
+    // Channel layouts, ITU-R BS.2051 order:
+    // SURR_5_1:   L R C LFE Ls Rs
+    // SURR_7_1:   L R C LFE Lss Rss Lrs Rrs
+    // SURR_7_1_4: L R C LFE Lss Rss Lrs Rrs Ltf Rtf Ltb Rtb
+    enum Layout { MONO, STEREO, SURR_5_0, SURR_5_1, SURR_7_1, SURR_7_1_4 };
+
     Ebu_r128_proc (void);
     ~Ebu_r128_proc (void);
 
+    // nchan = 5 is L R C Ls Rs, more than 5 channels have unit gain.
     void  init (int nchan, float fsamp);
+    void  init (Layout layout, float fsamp);
+    // BS.1770-4 channel weighting, 0 excludes a channel (LFE).
+    void  set_chan_gain (int chan, float gain) { _chan_gain [chan] = gain; }
+    float chan_gain (int chan) const { return _chan_gain [chan]; }
+    static int layout_nchan (Layout layout);
+    // Loudness update interval in ms, EBU_HOP by default. It must
+    // divide 100, be at least EBU_MINHOP and a whole number of samples
+    // (the default is rounded down if it is not). Resets the processor,
+    // returns non-zero if msec is not valid. Not realtime safe. init()
+    // keeps the hop if it is valid at the new rate, else uses EBU_HOP.
+    int   set_hop (int msec);
+    int   hop (void) const { return _hop; }
     void  reset (void);
-    void  process (int nfram, float *input []);
+    // The caller must flush denormals, see jmeters/denormalguard.h
+    void  process (int nfram, float *input [], float *output [] = 0);
     void  integr_reset (void);
     void  integr_pause (void) { _integr = false; }
     void  integr_start (void) { _integr = true; }
+    // Integrated loudness and range are updated every 500 ms while
+    // integrating, this updates them now (e.g. at the end of a file).
+    void  integr_update (void);
+    // Adds the histograms and maxima of P, measured on another part of
+    // the same programme, and updates integrated loudness and range.
+    // The result equals a single pass if the parts do not overlap, and
+    // each part has the same fragment grid and 500 ms phase as the
+    // single pass would, and starts with a warm-up of at least 3 s
+    // processed while integration is paused, followed by integr_reset()
+    // to drop the maxima of the filter onset (see x42-r128scan -s).
+    void  integr_merge (const Ebu_r128_proc &P);
+    int   fragm_size (void) const { return _fragm; }
+    int   integr_period (void) const { return _fragm * _per_S; }
 
     float loudness_M (void) const { return _loudness_M; }
     float maxloudn_M (void) const { return _maxloudn_M; }
@@ -95,21 +151,31 @@ public:
 
 private:
 
-    float addfrags (int nfrag);
+    void  addfrag (float p);
     void  detect_init (float fsamp);
     void  detect_reset (void);
     float detect_process (int nfram);
+    void  detect_copy (int nfram);
 
     bool              _integr;       // Integration on/off.
-    int               _nchan;        // Number of channels, 2 or 5.
+    int               _nchan;        // Number of channels, 1 .. MAXCH.
     float             _fsamp;        // Sample rate.
-    int               _fragm;        // Fragmenst size, 1/20 second.
+    int               _fragm;        // Fragment size, one hop.
     int               _frcnt;        // Number of samples remaining in current fragment.
     float             _frpwr;        // Power accumulated for current fragment.
-    float             _power [64];   // Array of fragment powers.
-    int               _wrind;        // Write index into _frpwr 
-    int               _div1;         // M period counter, 200 ms;
-    int               _div2;         // S period counter, 1s;
+    int               _hop;          // Hop in ms.
+    int               _nfr_M;        // Fragments per M window, 400 ms.
+    int               _nfr_S;        // Fragments per S window, 3 s.
+    int               _per_M;        // Fragments per M histogram point, 100 ms.
+    int               _per_S;        // Fragments per S histogram point, 500 ms.
+    float             _power [EBU_NFRAG]; // Ring of fragment powers.
+    int               _wrind;        // Write index into _power.
+    double            _sum_M;        // Running sum of the last _nfr_M powers.
+    double            _sum_S;        // Running sum of the last _nfr_S powers.
+    int               _nsum;         // Fragments since the sums were recomputed.
+    int               _nfill;        // Fragments since reset, up to _nfr_S.
+    int               _div1;         // M period counter, 100 ms;
+    int               _div2;         // S period counter, 500 ms;
     float             _loudness_M;
     float             _maxloudn_M;
     float             _loudness_S;
@@ -125,12 +191,18 @@ private:
     float             _b1, _b2;
     float             _c3, _c4;
     float            *_ipp [MAXCH];
-    Ebu_r128_fst      _fst [MAXCH];
+    float            *_opp [MAXCH];  // Pass-through, or 0.
+    bool              _alias;        // An output overlaps an input.
+    int               _nact;         // Number of channels with non-zero gain.
+    int               _lchan [EBU_NLANE]; // Channel of each filter lane.
+    float             _lgain [EBU_NLANE]; // Gain of each lane, 0 for padding.
+    Ebu_r128_fst      _fst;
     Ebu_r128_hist     _hist_M;
     Ebu_r128_hist     _hist_S;
+    float             _chan_gain [MAXCH];
 
-    // Default channel gains.
-    static float      _chan_gain [5];
+    // Channel gains per layout.
+    static const float _layout_gain [6][MAXCH];
 };
 
 };
@@ -38,6 +38,7 @@
 #endif
 
 #include "src/uris.h"
+#include "src/ebu_history.h"
 
 #ifndef MAX
 #define MAX(A,B) ( (A) > (B) ? (A) : (B) )
@@ -1762,6 +1763,80 @@ static void parse_radarinfo(EBUrUI* ui, const LV2_Atom_Object* obj) {
 	ui->radar_pos_cur = c;
 }
 
+/* fill the radar from the plugin's loudness log, returns false
+ * if the file cannot be read, e.g. when the UI runs on another host */
+static bool parse_history(EBUrUI* ui, const LV2_Atom_Object* obj) {
+#ifdef EBU_HISTORY
+	const EBULV2URIs* uris = &ui->uris;
+
+	LV2_Atom *hf = NULL;
+	LV2_Atom *pp = NULL;
+	LV2_Atom *pc = NULL;
+	LV2_Atom *pm = NULL;
+	LV2_Atom *bl = NULL;
+
+	float binlen = 0;
+	int c,m;
+	c=m=-1;
+
+	lv2_atom_object_get(obj,
+			uris->rdr_histfile, &hf,
+			uris->rdr_pointpos, &pp,
+			uris->rdr_pos_cur, &pc,
+			uris->rdr_pos_max, &pm,
+			uris->rdr_binlen, &bl,
+			NULL
+			);
+
+	PARSE_A_INT(pc, c);
+	PARSE_A_INT(pm, m);
+	PARSE_A_FLOAT(bl, binlen);
+
+	if (!hf || hf->type != ui->forge.Path) return false;
+	if (!pp || pp->type != uris->atom_Long) return false;
+	if (m < 1 || c < 0 || c >= m || binlen <= 0) return false;
+
+	EbuHistory* h = ebu_history_open((const char*)LV2_ATOM_BODY(hf));
+	if (!h) return false;
+
+	if (m != ui->radar_pos_max) {
+		ui->radarS = (float*) realloc((void*) ui->radarS, sizeof(float) * m);
+		ui->radarM = (float*) realloc((void*) ui->radarM, sizeof(float) * m);
+		ui->radar_pos_max = m;
+	}
+	for (int i=0; i < ui->radar_pos_max; ++i) {
+		ui->radarS[i] = -INFINITY;
+		ui->radarM[i] = -INFINITY;
+	}
+
+	/* radar positions before the current one, newest first */
+	/* the plugin's write thread may not have caught up with end yet */
+	uint64_t first;
+	const int64_t last = ebu_history_range(h, &first);
+	const int64_t end = ((LV2_Atom_Long*)pp)->body;
+	for (int j = 1; j < m; ++j) {
+		const int64_t p0 = end - llrint(j * binlen);
+		const int64_t p1 = end - llrint((j - 1) * binlen);
+		if (p0 < (int64_t)first) break;
+		float xlm = -INFINITY;
+		float xls = -INFINITY;
+		for (int64_t n = p0; n < p1 && n < last; ++n) {
+			const EbuHistoryPoint* p = ebu_history_point(h, n);
+			xlm = MAX(xlm, ebu_history_dec(p->m));
+			xls = MAX(xls, ebu_history_dec(p->s));
+		}
+		ui->radarM[(c - j + m) % m] = xlm;
+		ui->radarS[(c - j + m) % m] = xls;
+	}
+	ui->radar_pos_cur = c;
+
+	ebu_history_close(h);
+	return true;
+#else
+	return false;
+#endif
+}
+
 static void parse_histogram(EBUrUI* ui, const LV2_Atom_Object* obj) {
 	const EBULV2URIs* uris = &ui->uris;
 	LV2_Atom *lm = NULL;
@@ -1886,6 +1961,12 @@ port_event(LV2UI_Handle handle,
 				if (robtk_rbtn_get_active(ui->cbx_radar)) {
 					invalidate_changed(ui, 4);
 				}
+			} else if (obj->body.otype == uris->rdr_history) {
+				if (parse_history(ui, obj)) {
+					invalidate_changed(ui, -1);
+				} else {
+					forge_message_kv(ui, uris->mtr_meters_cfg, CTL_RADARRESYNC, 0);
+				}
 			} else if (obj->body.otype == uris->rdr_histpoint) {
 				parse_histogram(ui, obj);
 			} else if (obj->body.otype == uris->rdr_histogram) {
@@ -0,0 +1,373 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <math.h>
+#include "jmeterkernel.h"
+#include "busmeterdsp.h"
+
+namespace LV2M {
+
+#ifdef __SSE__
+typedef LaneSSE LaneBus;
+#else
+/* Four lanes in plain C++, for the compiler to vectorize */
+struct LaneBus
+{
+    struct V { float v [4]; };
+    enum { N = 4 };
+    static inline V set1 (float a) { V r; for (int i = 0; i < 4; ++i) r.v [i] = a; return r; }
+    static inline V load (const float *p) { V r; for (int i = 0; i < 4; ++i) r.v [i] = p [i]; return r; }
+    static inline void store (float *p, V a) { for (int i = 0; i < 4; ++i) p [i] = a.v [i]; }
+    static inline V add (V a, V b) { for (int i = 0; i < 4; ++i) a.v [i] += b.v [i]; return a; }
+    static inline V sub (V a, V b) { for (int i = 0; i < 4; ++i) a.v [i] -= b.v [i]; return a; }
+    static inline V mul (V a, V b) { for (int i = 0; i < 4; ++i) a.v [i] *= b.v [i]; return a; }
+    static inline V max (V a, V b) { for (int i = 0; i < 4; ++i) a.v [i] = LaneFlt::max (a.v [i], b.v [i]); return a; }
+    static inline V abs (V a) { for (int i = 0; i < 4; ++i) a.v [i] = fabsf (a.v [i]); return a; }
+    static inline V rise (V z, V t, V w)
+    {
+	for (int i = 0; i < 4; ++i) z.v [i] += w.v [i] * LaneFlt::max (t.v [i] - z.v [i], 0.f);
+	return z;
+    }
+    static inline V gather1 (float * const *p, int j)
+    {
+	V r;
+	for (int i = 0; i < 4; ++i) r.v [i] = p [i][j];
+	return r;
+    }
+    static inline void gather4 (float * const *p, int j, V &r0, V &r1, V &r2, V &r3)
+    {
+	r0 = gather1 (p, j);
+	r1 = gather1 (p, j + 1);
+	r2 = gather1 (p, j + 2);
+	r3 = gather1 (p, j + 3);
+    }
+};
+#endif
+
+
+/* K-meter, VU and both PPMs, sharing the rectified input.
+ * The K-meter squares it, |s|^2 = s^2.
+ */
+template <class L>
+struct BusKernel
+{
+    typedef typename L::V V;
+    BusKernel (const KmeterKernel<L> &k, const VumeterKernel<L> &v, const IecppmKernel<L> &p) :
+	_k (k), _v (v), _p (p) {}
+
+    inline void block4 (V s0, V s1, V s2, V s3)
+    {
+	s0 = L::abs (s0);
+	s1 = L::abs (s1);
+	s2 = L::abs (s2);
+	s3 = L::abs (s3);
+	_k.block4 (s0, s1, s2, s3);
+	_v.block4r (s0, s1, s2, s3);
+	_p.block4r (s0, s1, s2, s3);
+    }
+
+    inline void begin (void)
+    {
+	_k.begin ();
+	_v.begin ();
+	_p.begin ();
+    }
+    inline void step (V s)
+    {
+	s = L::abs (s);
+	_k.step (s);
+	_v.stepr (s);
+	_p.stepr (s);
+    }
+    inline void end (void)
+    {
+	_k.end ();
+	_v.end ();
+	_p.end ();
+    }
+
+    KmeterKernel<L>  _k;
+    VumeterKernel<L> _v;
+    IecppmKernel<L>  _p;
+};
+
+
+/* Copy both channels. Every sample of l and r is read before its
+ * output is written, so ql may alias pr (and qr pl).
+ */
+static inline void copy2 (const float *pl, const float *pr, float *ql, float *qr, int n, bool nt)
+{
+    int i = 0;
+#ifdef __SSE__
+    for (; i + 4 <= n; i += 4)
+    {
+	const __m128 l = _mm_loadu_ps (pl + i);
+	const __m128 r = _mm_loadu_ps (pr + i);
+	if (nt && !((uintptr_t)(ql + i) & 15)) _mm_stream_ps (ql + i, l); else _mm_storeu_ps (ql + i, l);
+	if (nt && !((uintptr_t)(qr + i) & 15)) _mm_stream_ps (qr + i, r); else _mm_storeu_ps (qr + i, r);
+    }
+#endif
+    for (; i < n; ++i)
+    {
+	const float l = pl [i];
+	const float r = pr [i];
+	ql [i] = l;
+	qr [i] = r;
+    }
+}
+
+
+static inline float clamp (float v, float lo, float hi)
+{
+    return v > hi ? hi : (v < lo ? lo : v);
+}
+
+
+Busmeterdsp::Busmeterdsp (void) :
+    _ph (0),
+    _fpp (0),
+    _fall (0),
+    _kcoef (0),
+    _vcoef (0),
+    _p1coef (0),
+    _p2coef (0)
+{
+    for (int c = 0; c < 4; ++c) _pw1 [c] = _pw2 [c] = _pw3 [c] = 0;
+    reset ();
+}
+
+
+Busmeterdsp::~Busmeterdsp (void)
+{
+    Jmetercoeff::destroy (_kcoef);
+    Jmetercoeff::destroy (_vcoef);
+    Jmetercoeff::destroy (_p1coef);
+    Jmetercoeff::destroy (_p2coef);
+}
+
+
+void Busmeterdsp::init (float fsamp)
+{
+    Jmetercoeff::destroy (_kcoef);
+    Jmetercoeff::destroy (_vcoef);
+    Jmetercoeff::destroy (_p1coef);
+    Jmetercoeff::destroy (_p2coef);
+    _kcoef  = Jmetercoeff::create (Jmetercoeff::KMETER, fsamp);
+    _vcoef  = Jmetercoeff::create (Jmetercoeff::VUMETER, fsamp);
+    _p1coef = Jmetercoeff::create (Jmetercoeff::IEC1PPM, fsamp);
+    _p2coef = Jmetercoeff::create (Jmetercoeff::IEC2PPM, fsamp);
+
+    for (int c = 0; c < 4; ++c)
+    {
+	const Jmetercoeff *C = c < 2 ? _p1coef : _p2coef;
+	_pw1 [c] = C->_w1;
+	_pw2 [c] = C->_w2;
+	_pw3 [c] = C->_w3;
+    }
+
+    _cor.init (fsamp, 2e3f, 0.3f);
+    _tp.init (2, fsamp);
+    _fpp = 0;
+    reset ();
+}
+
+
+void Busmeterdsp::reset (void)
+{
+    for (int c = 0; c < 4; ++c)
+    {
+	_kz1 [c] = _kz2 [c] = _kt [c] = 0;
+	_vz1 [c] = _vz2 [c] = _vm [c] = 0;
+	_pz1 [c] = _pz2 [c] = _pm [c] = 0;
+	_pres [c] = true;
+    }
+    for (int c = 0; c < 2; ++c)
+    {
+	_rms [c] = _peak [c] = 0;
+	_cnt [c] = 0;
+	_kres [c] = false;
+	_vres [c] = true;
+    }
+    _ph = 0;
+}
+
+
+void Busmeterdsp::process (float *pl, float *pr, int n, float *ql, float *qr)
+{
+    typedef LaneBus L;
+    int c;
+
+    for (c = 0; c < 4; ++c)
+    {
+	_kz1 [c] = clamp (_kz1 [c], 0, 50);
+	_kz2 [c] = clamp (_kz2 [c], 0, 50);
+	_vz1 [c] = clamp (_vz1 [c], -20, 20);
+	_vz2 [c] = clamp (_vz2 [c], -20, 20);
+	_pz1 [c] = clamp (_pz1 [c], 0, 20);
+	_pz2 [c] = clamp (_pz2 [c], 0, 20);
+	if (_pres [c]) _pm [c] = 0;
+	_pres [c] = false;
+    }
+    for (c = 0; c < 2; ++c)
+    {
+	if (_vres [c]) _vm [c] = _vm [c + 2] = 0;
+	_vres [c] = false;
+    }
+
+    BusKernel<L> k (
+	    KmeterKernel<L> (_kcoef->_w1, L::load (_kz1), L::load (_kz2)),
+	    VumeterKernel<L> (_vcoef->_w1, L::load (_vz1), L::load (_vz2), L::load (_vm)),
+	    IecppmKernel<L> (L::load (_pw1), L::load (_pw2), L::load (_pw3), L::load (_pz1), L::load (_pz2), L::load (_pm)));
+
+    const bool nt = ql && n >= JMETER_NT_MIN;
+
+    for (int i = 0; i < n; i += BUSMETER_CHUNK)
+    {
+	const int m = n - i < BUSMETER_CHUNK ? n - i : BUSMETER_CHUNK;
+	float *pp [4] = { pl + i, pr + i, pl + i, pr + i };
+
+	_ph = jmeter_run<8> (k, SrcLanes<L> (pp), m, _ph);
+	_cor.process (pl + i, pr + i, m);
+	_tp.process (pp, m);
+	if (ql) copy2 (pl + i, pr + i, ql + i, qr + i, m, nt);
+    }
+#ifdef __SSE__
+    if (nt) _mm_sfence ();
+#endif
+
+    L::store (_kz1, k._k._z1);
+    L::store (_kz2, k._k._z2);
+    L::store (_kt,  k._k._t);
+    L::store (_vz1, k._v._z1);
+    L::store (_vz2, k._v._z2);
+    L::store (_vm,  k._v._m);
+    L::store (_pz1, k._p._z1);
+    L::store (_pz2, k._p._z2);
+    L::store (_pm,  k._p._m);
+
+    fini (n);
+}
+
+
+/* Per period, same as Lanemeterdsp */
+void Busmeterdsp::fini (int n)
+{
+    if (_fpp != n)
+    {
+	const float fall = 15.0f;
+	const float tme = (float) n / _kcoef->_fsamp; // period time in seconds
+	_fall = powf (10.0f, -0.05f * fall * tme); // per period fallback multiplier
+	_fpp = n;
+    }
+
+    for (int c = 0; c < 2; ++c)
+    {
+	// K-meter
+	float s, t;
+	if (isnan (_kz1 [c])) _kz1 [c] = 0;
+	if (isnan (_kz2 [c])) _kz2 [c] = 0;
+	t = _kt [c];
+	if (!isfinite (t)) t = 0;
+
+	// The added constants avoid denormals.
+	_kz1 [c] += 1e-20f;
+	_kz2 [c] += 1e-20f;
+
+	s = sqrtf (2.0f * _kz2 [c]);
+	t = sqrtf (t);
+
+	if (_kres [c]) // Display thread has read the rms value.
+	{
+	    _rms [c] = s;
+	    _kres [c] = false;
+	}
+	else if (s > _rms [c])
+	{
+	    _rms [c] = s;
+	}
+
+	// Digital peak hold and fallback.
+	if (t >= _peak [c])
+	{
+	    _peak [c] = t;
+	    _cnt [c] = _kcoef->_hold;
+	}
+	else if (_cnt [c] > 0)
+	{
+	    _cnt [c] -= _fpp;
+	}
+	else
+	{
+	    _peak [c] *= _fall;
+	    _peak [c] += 1e-10f;
+	}
+
+	// VU
+	if (!isfinite (_vz1 [c])) { _vz1 [c] = 0; _vm [c] = INFINITY; }
+	if (!isfinite (_vz2 [c])) { _vz2 [c] = 0; _vm [c] = INFINITY; } else _vz2 [c] += 1e-10f;
+
+	// Lanes 2, 3 of the K-meter and VU follow 0, 1
+	_kz1 [c + 2] = _kz1 [c];
+	_kz2 [c + 2] = _kz2 [c];
+	_vz1 [c + 2] = _vz1 [c];
+	_vz2 [c + 2] = _vz2 [c];
+    }
+
+    for (int c = 0; c < 4; ++c)
+    {
+	_pz1 [c] += 1e-10f;
+	_pz2 [c] += 1e-10f;
+    }
+}
+
+
+float Busmeterdsp::read_vu (int c)
+{
+    _vres [c] = true;
+    return _vcoef->_g * _vm [c];
+}
+
+
+float Busmeterdsp::read_iec1 (int c)
+{
+    _pres [c] = true;
+    return _p1coef->_g * _pm [c];
+}
+
+
+float Busmeterdsp::read_iec2 (int c)
+{
+    _pres [c + 2] = true;
+    return _p2coef->_g * _pm [c + 2];
+}
+
+
+void Busmeterdsp::read_kmeter (int c, float &rms, float &peak)
+{
+    rms  = _rms [c];
+    peak = _peak [c];
+    _kres [c] = true; // Resets _rms in next process().
+}
+
+
+void Busmeterdsp::read_truepeak (int c, float &m, float &p)
+{
+    _tp.read (c, m, p);
+}
+
+};
+/* vi:set ts=8 sts=8 sw=4: */
@@ -0,0 +1,100 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __BUSMETERDSP_H
+#define	__BUSMETERDSP_H
+
+#include "jmetercoeff.h"
+#include "stcorrdsp.h"
+#include "truepeakmultidsp.h"
+
+#define BUSMETER_CHUNK 256
+
+namespace LV2M {
+
+/* All level standards of a stereo bus in a single pass.
+ *
+ * Same filters as Vumeterdsp, Iec1ppmdsp, Iec2ppmdsp, Kmeterdsp,
+ * TruePeakdsp and Stcorrdsp. The input is processed in chunks of
+ * BUSMETER_CHUNK samples: the ballistics of all meters share one
+ * loop and the rectified input, correlation and true-peak then
+ * read the same chunk while it is still in L1.
+ *
+ * Ballistics lanes are (L, R, L, R). The PPM kernel runs type I
+ * in lanes 0, 1 and type II in lanes 2, 3; K-meter and VU only
+ * use lanes 0 and 1.
+ */
+class Busmeterdsp
+{
+public:
+
+    Busmeterdsp (void);
+    ~Busmeterdsp (void);
+
+    void init (float fsamp);
+    // if ql is not 0, pl and pr are copied to ql and qr
+    void process (float *pl, float *pr, int n, float *ql = 0, float *qr = 0);
+    void reset (void);
+
+    float read_vu (int c);
+    float read_iec1 (int c);
+    float read_iec2 (int c);
+    void  read_kmeter (int c, float &rms, float &peak);
+    void  read_truepeak (int c, float &m, float &p);
+    float read_cor (void) { return _cor.read (); }
+
+private:
+
+    void fini (int n);
+
+    int            _ph;          // position in the current 4 sample sub-block
+
+    float          _kz1 [4];     // K-meter filter state
+    float          _kz2 [4];
+    float          _kt [4];      // K-meter digital peak of last period
+    float          _vz1 [4];     // VU filter state
+    float          _vz2 [4];
+    float          _vm [4];      // VU max value since last read()
+    float          _pz1 [4];     // PPM filter state, type I in lanes 0, 1, type II in 2, 3
+    float          _pz2 [4];
+    float          _pm [4];      // PPM max value since last read()
+    float          _pw1 [4];     // PPM coefficients per lane
+    float          _pw2 [4];
+    float          _pw3 [4];
+
+    float          _rms [2];     // K-meter max rms value since last read()
+    float          _peak [2];    // K-meter max peak value since last read()
+    int            _cnt [2];     // K-meter digital peak hold counter
+    bool           _kres [2];    // reset _rms in next process()
+    bool           _vres [2];    // reset _vm in next process()
+    bool           _pres [4];    // reset _pm in next process()
+
+    int            _fpp;         // frames per period
+    float          _fall;        // K-meter peak fallback
+
+    Stcorrdsp      _cor;
+    TruePeakMultidsp _tp;
+
+    const Jmetercoeff *_kcoef;   // ballistics
+    const Jmetercoeff *_vcoef;
+    const Jmetercoeff *_p1coef;
+    const Jmetercoeff *_p2coef;
+};
+
+};
+
+#endif
@@ -0,0 +1,96 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __DENORMALGUARD_H
+#define	__DENORMALGUARD_H
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace LV2M {
+
+/* Flush denormals to zero for the lifetime of the object, and restore
+ * the caller's floating point mode afterwards. Instantiate on the
+ * stack at the start of every run() callback; the DSP code relies on
+ * it and does not add bias constants in its inner loops, see
+ * tools/denormbench.cc (`make bench`).
+ *
+ * x86: MXCSR FTZ, plus DAZ with SSE2 (DAZ faults on the very first SSE CPUs).
+ * ARM: FPCR/FPSCR FZ. Other architectures: no-op.
+ */
+class DenormalGuard
+{
+public:
+
+#if defined __SSE__
+    DenormalGuard (void) : _csr (_mm_getcsr ())
+    {
+# ifdef __SSE2__
+	_mm_setcsr (_csr | 0x8040); // FTZ | DAZ
+# else
+	_mm_setcsr (_csr | 0x8000); // FTZ
+# endif
+    }
+    ~DenormalGuard (void) { _mm_setcsr (_csr); }
+
+private:
+
+    unsigned int _csr;
+
+#elif defined __aarch64__
+    DenormalGuard (void)
+    {
+	unsigned long fpcr;
+	__asm__ __volatile__ ("mrs %0, fpcr" : "=r" (_csr));
+	fpcr = _csr | (1UL << 24); // FZ
+	__asm__ __volatile__ ("msr fpcr, %0" : : "r" (fpcr));
+    }
+    ~DenormalGuard (void) { __asm__ __volatile__ ("msr fpcr, %0" : : "r" (_csr)); }
+
+private:
+
+    unsigned long _csr;
+
+#elif defined __arm__ && defined __VFP_FP__ && !defined __SOFTFP__
+    DenormalGuard (void)
+    {
+	unsigned int fpscr;
+	__asm__ __volatile__ ("vmrs %0, fpscr" : "=r" (_csr));
+	fpscr = _csr | (1U << 24); // FZ
+	__asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (fpscr));
+    }
+    ~DenormalGuard (void) { __asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (_csr)); }
+
+private:
+
+    unsigned int _csr;
+
+#else
+    DenormalGuard (void) {}
+    ~DenormalGuard (void) {}
+#endif
+
+private:
+
+    DenormalGuard (const DenormalGuard&);
+    DenormalGuard& operator= (const DenormalGuard&);
+};
+
+};
+
+#endif
@@ -23,6 +23,7 @@
 #define	__IEC1PPMDSP_H
 
 #include "jmeterdsp.h"
+#include "jmetercoeff.h"
 
 namespace LV2M {
 
@@ -33,10 +34,11 @@ public:
     Iec1ppmdsp (void);
     ~Iec1ppmdsp (void);
 
-    void process (float *p, int n);  
+    void process (float *p, int n);
+    void process (float *p, float *q, int n); // and copy p to q
     float read (void);
 
-    static void init (float fsamp); 
+    void init (float fsamp);
 
 private:
 
@@ -44,11 +46,9 @@ private:
     float          _z2;          // filter state
     float          _m;           // max value since last read()
     bool           _res;         // flag to reset m
+    int            _ph;          // position in the current 4 sample sub-block
 
-    static float   _w1;          // attack filter coefficient
-    static float   _w2;          // attack filter coefficient
-    static float   _w3;          // release filter coefficient
-    static float   _g;           // gain factor
+    const Jmetercoeff *_coef;    // attack/release filter coefficients, gain factor
 };
 
 };
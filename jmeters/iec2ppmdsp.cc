@@ -20,79 +20,67 @@
 
 
 #include <math.h>
+#include "jmeterkernel.h"
 #include "iec2ppmdsp.h"
 
 namespace LV2M {
 
-float  Iec2ppmdsp::_w1 = 0;
-float  Iec2ppmdsp::_w2 = 0;
-float  Iec2ppmdsp::_w3 = 0;
-float  Iec2ppmdsp::_g = 0; 
-
-
 Iec2ppmdsp::Iec2ppmdsp (void) :
     _z1 (0),
     _z2 (0),
     _m (0),
-    _res (true)
+    _res (true),
+    _ph (0),
+    _coef (0)
 {
 }
 
 
 Iec2ppmdsp::~Iec2ppmdsp (void)
 {
+    Jmetercoeff::destroy (_coef);
 }
 
 
 void Iec2ppmdsp::process (float *p, int n)
 {
-    float z1, z2, m, t;
+    process (p, 0, n);
+}
+
+
+void Iec2ppmdsp::process (float *p, float *q, int n)
+{
+    float z1, z2, m;
+    const float w1 = _coef->_w1;
+    const float w2 = _coef->_w2;
+    const float w3 = _coef->_w3;
 
     z1 = _z1 > 20 ? 20 : (_z1 < 0 ? 0 : _z1);
     z2 = _z2 > 20 ? 20 : (_z2 < 0 ? 0 : _z2);
     m = _res ? 0: _m;
     _res = false;
 
-    n /= 4;
-    while (n--)
-    {
-	z1 *= _w3;
-	z2 *= _w3;
-	t = fabsf (*p++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = fabsf (*p++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = fabsf (*p++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = fabsf (*p++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = z1 + z2;
-	if (t > m) m = t;
-    }
-
-    _z1 = z1 + 1e-10f;
-    _z2 = z2 + 1e-10f;
-    _m = m;
+    IecppmKernel<LaneFlt> k (w1, w2, w3, z1, z2, m);
+    if (q) _ph = jmeter_run<8> (k, SrcMonoCopy (p, q, n), n, _ph);
+    else   _ph = jmeter_run<8> (k, SrcMono (p), n, _ph);
+
+    _z1 = k._z1 + 1e-10f;
+    _z2 = k._z2 + 1e-10f;
+    _m = k._m;
 }
 
 
 float Iec2ppmdsp::read (void)
 {
     _res = true;
-    return _g * _m;
+    return _coef->_g * _m;
 }
 
 
 void Iec2ppmdsp::init (float fsamp)
 {
-    _w1 = 200.0f / fsamp;
-    _w2 = 860.0f / fsamp;
-    _w3 = 1.0f - 4.0f / fsamp;
-    _g = 0.5141f;
+    Jmetercoeff::destroy (_coef);
+    _coef = Jmetercoeff::create (Jmetercoeff::IEC2PPM, fsamp);
 }
 
 }
@@ -0,0 +1,117 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <pthread.h>
+#include "jmetercoeff.h"
+
+namespace LV2M {
+
+static pthread_mutex_t _coeff_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+Jmetercoeff *Jmetercoeff::_list = 0;
+
+
+Jmetercoeff::Jmetercoeff (Type type, float fsamp, float p1, float p2) :
+    _fsamp (fsamp),
+    _w1 (0),
+    _w2 (0),
+    _w3 (0),
+    _g (0),
+    _hold (0),
+    _next (0),
+    _refc (0),
+    _type (type),
+    _p1 (p1),
+    _p2 (p2)
+{
+    switch (type)
+    {
+	case KMETER:
+	    _hold = (int)(0.5f * fsamp + 0.5f); // number of samples to hold peak
+	    _w1 = 9.72f / fsamp; // ballistic filter coefficient
+	    break;
+	case IEC1PPM:
+	    _w1 =  450.0f / fsamp;
+	    _w2 = 1300.0f / fsamp;
+	    _w3 = 1.0f - 5.4f / fsamp;
+	    _g = 0.5108f;
+	    break;
+	case IEC2PPM:
+	    _w1 = 200.0f / fsamp;
+	    _w2 = 860.0f / fsamp;
+	    _w3 = 1.0f - 4.0f / fsamp;
+	    _g = 0.5141f;
+	    break;
+	case VUMETER:
+	    _w1 = 11.1f / fsamp;
+	    _g = 1.5f * 1.571f;
+	    break;
+	case STCORR:
+	    // p1 = lowpass frequency
+	    // p2 = correlation filter time constant
+	    _w1 = 6.28f * p1 / fsamp;
+	    _w2 = 1 / (p2 * fsamp);
+	    break;
+    }
+}
+
+
+const Jmetercoeff *Jmetercoeff::create (Type type, float fsamp, float p1, float p2)
+{
+    Jmetercoeff *P;
+
+    pthread_mutex_lock (&_coeff_mutex);
+    for (P = _list; P; P = P->_next)
+    {
+	if (P->_type == type && P->_fsamp == fsamp && P->_p1 == p1 && P->_p2 == p2)
+	{
+	    P->_refc++;
+	    pthread_mutex_unlock (&_coeff_mutex);
+	    return P;
+	}
+    }
+    P = new Jmetercoeff (type, fsamp, p1, p2);
+    P->_refc = 1;
+    P->_next = _list;
+    _list = P;
+    pthread_mutex_unlock (&_coeff_mutex);
+    return P;
+}
+
+
+void Jmetercoeff::destroy (const Jmetercoeff *T)
+{
+    Jmetercoeff *P, *Q;
+
+    if (!T) return;
+    pthread_mutex_lock (&_coeff_mutex);
+    for (P = _list, Q = 0; P; Q = P, P = P->_next)
+    {
+	if (P != T) continue;
+	if (--P->_refc == 0)
+	{
+	    if (Q) Q->_next = P->_next;
+	    else   _list = P->_next;
+	    delete P;
+	}
+	break;
+    }
+    pthread_mutex_unlock (&_coeff_mutex);
+}
+
+};
+/* vi:set ts=8 sts=8 sw=4: */
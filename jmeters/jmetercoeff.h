@@ -0,0 +1,66 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __JMETERCOEFF_H
+#define	__JMETERCOEFF_H
+
+namespace LV2M {
+
+/* Immutable per sample-rate ballistics coefficients.
+ *
+ * Tables are reference counted and shared by all meter
+ * instances of the same type and rate (cf. Resampler_table).
+ */
+class Jmetercoeff
+{
+public:
+
+    enum Type {
+	KMETER = 0,
+	IEC1PPM,
+	IEC2PPM,
+	VUMETER,
+	STCORR
+    };
+
+    static const Jmetercoeff *create (Type type, float fsamp, float p1 = 0, float p2 = 0);
+    static void destroy (const Jmetercoeff *C);
+
+    const float    _fsamp;       // sample-rate
+    float          _w1;          // attack, ballistic or lowpass filter coefficient
+    float          _w2;          // attack or correlation filter coefficient
+    float          _w3;          // release filter coefficient
+    float          _g;           // gain factor
+    int            _hold;        // peak hold timeout [samples]
+
+private:
+
+    Jmetercoeff (Type type, float fsamp, float p1, float p2);
+    ~Jmetercoeff (void) {}
+
+    Jmetercoeff   *_next;
+    unsigned int   _refc;
+    const Type     _type;
+    const float    _p1;
+    const float    _p2;
+
+    static Jmetercoeff *_list;
+};
+
+};
+
+#endif
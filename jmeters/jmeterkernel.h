@@ -0,0 +1,503 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __JMETERKERNEL_H
+#define	__JMETERKERNEL_H
+
+#include <math.h>
+#include <stdint.h>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+/* Pass-through of the metered signal (hosts that do not process
+ * in-place): the output is written while the input is read for
+ * metering. Periods of at least JMETER_NT_MIN samples use
+ * non-temporal stores where the output is aligned. They exceed the
+ * L1 cache, and streaming stores do not read the output lines
+ * before writing them.
+ */
+#define JMETER_NT_MIN 4096
+
+namespace LV2M {
+
+#ifdef __SSE__
+static inline __m128 jmeter_copy4 (const float *p, float *q, bool nt)
+{
+    const __m128 v = _mm_loadu_ps (p);
+    if (nt && !((uintptr_t) q & 15)) _mm_stream_ps (q, v);
+    else _mm_storeu_ps (q, v);
+    return v;
+}
+
+static inline void jmeter_split4 (__m128 v, float &r0, float &r1, float &r2, float &r3)
+{
+    r0 = _mm_cvtss_f32 (v);
+    r1 = _mm_cvtss_f32 (_mm_shuffle_ps (v, v, _MM_SHUFFLE (1, 1, 1, 1)));
+    r2 = _mm_cvtss_f32 (_mm_movehl_ps (v, v));
+    r3 = _mm_cvtss_f32 (_mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3)));
+}
+#endif
+
+/* Copy n samples, same store policy as the fused kernels. */
+static inline void jmeter_copy (const float *p, float *q, int n)
+{
+    int i = 0;
+#ifdef __SSE__
+    const bool nt = n >= JMETER_NT_MIN;
+    for (; i + 4 <= n; i += 4) jmeter_copy4 (p + i, q + i, nt);
+    if (nt) _mm_sfence ();
+#endif
+    for (; i < n; ++i) q [i] = p [i];
+}
+
+/* Lane abstraction. LaneFlt is a plain float, LaneSSE and LaneAVX
+ * hold one channel per lane.
+ *
+ * max (a, b) is  a > b ? a : b  i.e. it returns b if either is NaN,
+ * same as _mm_max_ps().
+ *
+ * rise (z, t, w) is the peak meter attack  (t > z) ? z + w * (t - z) : z
+ * The scalar version branches: the branch is rarely taken once the
+ * meter has settled, and predicts well. SIMD uses z + w * max (t - z, 0).
+ *
+ * gather4() loads 4 consecutive samples of N channels and transposes
+ * them, so that r0 holds sample j of every channel, r1 sample j + 1,
+ * etc. gather1() loads a single sample of every channel.
+ *
+ * sum (a) adds all lanes, for dot products along a single channel.
+ */
+
+struct LaneFlt
+{
+    typedef float V;
+    enum { N = 1 };
+    static inline V set1 (float a) { return a; }
+    static inline V load (const float *p) { return *p; }
+    static inline void store (float *p, V v) { *p = v; }
+    static inline V add (V a, V b) { return a + b; }
+    static inline V sub (V a, V b) { return a - b; }
+    static inline V mul (V a, V b) { return a * b; }
+    static inline V max (V a, V b) { return a > b ? a : b; }
+    static inline V abs (V a) { return fabsf (a); }
+    static inline V rise (V z, V t, V w) { if (t > z) z += w * (t - z); return z; }
+    static inline float sum (V a) { return a; }
+    static inline V gather1 (float * const *p, int j) { return p[0][j]; }
+    static inline void gather4 (float * const *p, int j, V &r0, V &r1, V &r2, V &r3)
+    {
+	r0 = p[0][j];
+	r1 = p[0][j + 1];
+	r2 = p[0][j + 2];
+	r3 = p[0][j + 3];
+    }
+    static inline void gather4copy (float * const *p, float * const *q, int j, bool, V &r0, V &r1, V &r2, V &r3)
+    {
+	r0 = q[0][j]     = p[0][j];
+	r1 = q[0][j + 1] = p[0][j + 1];
+	r2 = q[0][j + 2] = p[0][j + 2];
+	r3 = q[0][j + 3] = p[0][j + 3];
+    }
+};
+
+#ifdef __SSE__
+struct LaneSSE
+{
+    typedef __m128 V;
+    enum { N = 4 };
+    static inline V set1 (float a) { return _mm_set1_ps (a); }
+    static inline V load (const float *p) { return _mm_loadu_ps (p); }
+    static inline void store (float *p, V v) { _mm_storeu_ps (p, v); }
+    static inline V add (V a, V b) { return _mm_add_ps (a, b); }
+    static inline V sub (V a, V b) { return _mm_sub_ps (a, b); }
+    static inline V mul (V a, V b) { return _mm_mul_ps (a, b); }
+    static inline V max (V a, V b) { return _mm_max_ps (a, b); }
+    static inline V abs (V a) { return _mm_andnot_ps (_mm_set1_ps (-0.f), a); }
+    static inline V rise (V z, V t, V w) { return add (z, mul (w, max (sub (t, z), _mm_setzero_ps ()))); }
+    static inline float sum (V a)
+    {
+	a = _mm_add_ps (a, _mm_movehl_ps (a, a));
+	a = _mm_add_ss (a, _mm_shuffle_ps (a, a, _MM_SHUFFLE (1, 1, 1, 1)));
+	return _mm_cvtss_f32 (a);
+    }
+    static inline V gather1 (float * const *p, int j)
+    {
+	return _mm_setr_ps (p[0][j], p[1][j], p[2][j], p[3][j]);
+    }
+    static inline void gather4 (float * const *p, int j, V &r0, V &r1, V &r2, V &r3)
+    {
+	r0 = _mm_loadu_ps (p[0] + j);
+	r1 = _mm_loadu_ps (p[1] + j);
+	r2 = _mm_loadu_ps (p[2] + j);
+	r3 = _mm_loadu_ps (p[3] + j);
+	_MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+    }
+    static inline void gather4copy (float * const *p, float * const *q, int j, bool nt, V &r0, V &r1, V &r2, V &r3)
+    {
+	r0 = jmeter_copy4 (p[0] + j, q[0] + j, nt);
+	r1 = jmeter_copy4 (p[1] + j, q[1] + j, nt);
+	r2 = jmeter_copy4 (p[2] + j, q[2] + j, nt);
+	r3 = jmeter_copy4 (p[3] + j, q[3] + j, nt);
+	_MM_TRANSPOSE4_PS (r0, r1, r2, r3);
+    }
+};
+#endif
+
+#ifdef __AVX__
+struct LaneAVX
+{
+    typedef __m256 V;
+    enum { N = 8 };
+    static inline V set1 (float a) { return _mm256_set1_ps (a); }
+    static inline V load (const float *p) { return _mm256_loadu_ps (p); }
+    static inline void store (float *p, V v) { _mm256_storeu_ps (p, v); }
+    static inline V add (V a, V b) { return _mm256_add_ps (a, b); }
+    static inline V sub (V a, V b) { return _mm256_sub_ps (a, b); }
+    static inline V mul (V a, V b) { return _mm256_mul_ps (a, b); }
+    static inline V max (V a, V b) { return _mm256_max_ps (a, b); }
+    static inline V abs (V a) { return _mm256_andnot_ps (_mm256_set1_ps (-0.f), a); }
+    static inline V rise (V z, V t, V w) { return add (z, mul (w, max (sub (t, z), _mm256_setzero_ps ()))); }
+    static inline float sum (V a)
+    {
+	return LaneSSE::sum (_mm_add_ps (_mm256_castps256_ps128 (a), _mm256_extractf128_ps (a, 1)));
+    }
+    static inline V gather1 (float * const *p, int j)
+    {
+	return _mm256_setr_ps (p[0][j], p[1][j], p[2][j], p[3][j],
+			       p[4][j], p[5][j], p[6][j], p[7][j]);
+    }
+    static inline void gather4 (float * const *p, int j, V &r0, V &r1, V &r2, V &r3)
+    {
+	__m128 a0, a1, a2, a3, b0, b1, b2, b3;
+	LaneSSE::gather4 (p, j, a0, a1, a2, a3);
+	LaneSSE::gather4 (p + 4, j, b0, b1, b2, b3);
+	r0 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a0), b0, 1);
+	r1 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a1), b1, 1);
+	r2 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a2), b2, 1);
+	r3 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a3), b3, 1);
+    }
+    static inline void gather4copy (float * const *p, float * const *q, int j, bool nt, V &r0, V &r1, V &r2, V &r3)
+    {
+	__m128 a0, a1, a2, a3, b0, b1, b2, b3;
+	LaneSSE::gather4copy (p, q, j, nt, a0, a1, a2, a3);
+	LaneSSE::gather4copy (p + 4, q + 4, j, nt, b0, b1, b2, b3);
+	r0 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a0), b0, 1);
+	r1 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a1), b1, 1);
+	r2 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a2), b2, 1);
+	r3 = _mm256_insertf128_ps (_mm256_castps128_ps256 (a3), b3, 1);
+    }
+};
+#endif
+
+
+/* Sample sources, get1() returns sample i, get4() samples i .. i + 3.
+ * The ...Copy variants also write the samples they read to the
+ * output buffer(s), and are meant to be used as a temporary: the
+ * destructor fences the non-temporal stores.
+ */
+
+struct SrcMono
+{
+    SrcMono (const float *p) : _p (p) {}
+    inline float get1 (int i) const { return _p [i]; }
+    inline void get4 (int i, float &r0, float &r1, float &r2, float &r3) const
+    {
+	r0 = _p [i]; r1 = _p [i + 1]; r2 = _p [i + 2]; r3 = _p [i + 3];
+    }
+    const float *_p;
+};
+
+struct SrcMonoCopy
+{
+    SrcMonoCopy (const float *p, float *q, int n) : _p (p), _q (q), _nt (n >= JMETER_NT_MIN) {}
+#ifdef __SSE__
+    ~SrcMonoCopy (void) { if (_nt) _mm_sfence (); }
+#endif
+    inline float get1 (int i) const { return _q [i] = _p [i]; }
+    inline void get4 (int i, float &r0, float &r1, float &r2, float &r3) const
+    {
+#ifdef __SSE__
+	jmeter_split4 (jmeter_copy4 (_p + i, _q + i, _nt), r0, r1, r2, r3);
+#else
+	r0 = get1 (i); r1 = get1 (i + 1); r2 = get1 (i + 2); r3 = get1 (i + 3);
+#endif
+    }
+    const float *_p;
+    float       *_q;
+    const bool   _nt;
+};
+
+/* g * (l + r), g * (l - r) for the M/S PPM */
+template <bool SIDE, bool COPY = false>
+struct SrcMS
+{
+    SrcMS (const float *l, const float *r, float g, float *ql = 0, float *qr = 0, int n = 0) :
+	_l (l), _r (r), _ql (ql), _qr (qr), _g (g), _nt (n >= JMETER_NT_MIN) {}
+#ifdef __SSE__
+    ~SrcMS (void) { if (COPY && _nt) _mm_sfence (); }
+#endif
+    inline float get1 (int i) const
+    {
+	if (COPY) { _ql [i] = _l [i]; _qr [i] = _r [i]; }
+	return _g * (SIDE ? _l [i] - _r [i] : _l [i] + _r [i]);
+    }
+    inline void get4 (int i, float &r0, float &r1, float &r2, float &r3) const
+    {
+#ifdef __SSE__
+	if (COPY)
+	{
+	    const __m128 l = jmeter_copy4 (_l + i, _ql + i, _nt);
+	    const __m128 r = jmeter_copy4 (_r + i, _qr + i, _nt);
+	    const __m128 s = SIDE ? _mm_sub_ps (l, r) : _mm_add_ps (l, r);
+	    jmeter_split4 (_mm_mul_ps (_mm_set1_ps (_g), s), r0, r1, r2, r3);
+	    return;
+	}
+#endif
+	r0 = get1 (i); r1 = get1 (i + 1); r2 = get1 (i + 2); r3 = get1 (i + 3);
+    }
+    const float *_l, *_r;
+    float       *_ql, *_qr;
+    const float  _g;
+    const bool   _nt;
+};
+
+template <class L>
+struct SrcLanes
+{
+    SrcLanes (float * const *p) : _p (p) {}
+    inline typename L::V get1 (int i) const { return L::gather1 (_p, i); }
+    inline void get4 (int i, typename L::V &r0, typename L::V &r1, typename L::V &r2, typename L::V &r3) const
+    {
+	L::gather4 (_p, i, r0, r1, r2, r3);
+    }
+    float * const *_p;
+};
+
+template <class L>
+struct SrcLanesCopy
+{
+    SrcLanesCopy (float * const *p, float * const *q, int n) : _p (p), _q (q), _nt (n >= JMETER_NT_MIN) {}
+#ifdef __SSE__
+    ~SrcLanesCopy (void) { if (_nt) _mm_sfence (); }
+#endif
+    inline typename L::V get1 (int i) const
+    {
+	for (int c = 0; c < L::N; ++c) _q [c][i] = _p [c][i];
+	return L::gather1 (_p, i);
+    }
+    inline void get4 (int i, typename L::V &r0, typename L::V &r1, typename L::V &r2, typename L::V &r3) const
+    {
+	L::gather4copy (_p, _q, i, _nt, r0, r1, r2, r3);
+    }
+    float * const *_p;
+    float * const *_q;
+    const bool     _nt;
+};
+
+
+/* Ballistics. The filters run in sub-blocks of 4 samples:
+ * block4() processes a complete sub-block. A sub-block that is
+ * split between two calls is done by begin(), step() for every
+ * sample and end() after the 4th sample.
+ *
+ * The first order lowpass  z += w * (x - z)  of the K-meter and VU
+ * is, over 4 samples, z = a^4 z + w (a^3 x0 + a^2 x1 + a x2 + x3)
+ * with a = 1 - w. Only a single multiply-add per sub-block then
+ * depends on the previous value of z.
+ */
+
+/* K-meter, see Kmeterdsp::process() */
+template <class L>
+struct KmeterKernel
+{
+    typedef typename L::V V;
+    KmeterKernel (float omega, V z1, V z2) :
+	_w1 (L::set1 (omega)), _w2 (L::set1 (4 * omega)),
+	_a1 (L::set1 (1 - omega)),
+	_a2 (L::set1 ((1 - omega) * (1 - omega))),
+	_a3 (L::set1 ((1 - omega) * (1 - omega) * (1 - omega))),
+	_a4 (L::set1 ((1 - omega) * (1 - omega) * (1 - omega) * (1 - omega))),
+	_z1 (z1), _z2 (z2), _t (L::set1 (0)) {}
+
+    inline void block4 (V s0, V s1, V s2, V s3)
+    {
+	s0 = L::mul (s0, s0);
+	s1 = L::mul (s1, s1);
+	s2 = L::mul (s2, s2);
+	s3 = L::mul (s3, s3);
+	_t = L::max (L::max (s0, s1), L::max (L::max (s2, s3), _t));  // digital peak
+	s0 = L::add (L::mul (_a3, s0), L::mul (_a2, s1));
+	s2 = L::add (L::mul (_a1, s2), s3);
+	_z1 = L::add (L::mul (_a4, _z1), L::mul (_w1, L::add (s0, s2)));
+	_z2 = L::add (_z2, L::mul (_w2, L::sub (_z1, _z2)));
+    }
+
+    inline void begin (void) {}
+    inline void step (V s)
+    {
+	s = L::mul (s, s);
+	_t  = L::max (s, _t);
+	_z1 = L::add (_z1, L::mul (_w1, L::sub (s, _z1)));
+    }
+    inline void end (void)
+    {
+	_z2 = L::add (_z2, L::mul (_w2, L::sub (_z1, _z2)));
+    }
+
+    const V _w1, _w2, _a1, _a2, _a3, _a4;
+    V _z1, _z2, _t;
+};
+
+/* IEC type I and II PPM, see Iec1ppmdsp::process()
+ * The coefficients are per lane, a single kernel may run both types.
+ */
+template <class L>
+struct IecppmKernel
+{
+    typedef typename L::V V;
+    IecppmKernel (V w1, V w2, V w3, V z1, V z2, V m) :
+	_w1 (w1), _w2 (w2), _w3 (w3),
+	_z1 (z1), _z2 (z2), _m (m) {}
+
+    inline void block4 (V s0, V s1, V s2, V s3)
+    {
+	block4r (L::abs (s0), L::abs (s1), L::abs (s2), L::abs (s3));
+    }
+    inline void block4r (V t0, V t1, V t2, V t3) // rectified input
+    {
+	begin ();
+	stepr (t0);
+	stepr (t1);
+	stepr (t2);
+	stepr (t3);
+	end ();
+    }
+
+    inline void begin (void)
+    {
+	_z1 = L::mul (_z1, _w3);
+	_z2 = L::mul (_z2, _w3);
+    }
+    inline void step (V s) { stepr (L::abs (s)); }
+    inline void stepr (V t)
+    {
+	_z1 = L::rise (_z1, t, _w1);
+	_z2 = L::rise (_z2, t, _w2);
+    }
+    inline void end (void)
+    {
+	_m = L::max (L::add (_z1, _z2), _m);
+    }
+
+    const V _w1, _w2, _w3;
+    V _z1, _z2, _m;
+};
+
+/* VU, see Vumeterdsp::process() */
+template <class L>
+struct VumeterKernel
+{
+    typedef typename L::V V;
+    VumeterKernel (float w, V z1, V z2, V m) :
+	_w1 (L::set1 (w)), _w2 (L::set1 (4 * w)), _half (L::set1 (.5f)),
+	_a1 (L::set1 (1 - w)),
+	_a2 (L::set1 ((1 - w) * (1 - w))),
+	_a3 (L::set1 ((1 - w) * (1 - w) * (1 - w))),
+	_a4 (L::set1 ((1 - w) * (1 - w) * (1 - w) * (1 - w))),
+	_c4 (L::set1 (.5f * w * (1 + (1 - w) + (1 - w) * (1 - w) + (1 - w) * (1 - w) * (1 - w)))),
+	_z1 (z1), _z2 (z2), _m (m), _t2 (L::mul (z2, _half)) {}
+
+    inline void block4 (V s0, V s1, V s2, V s3)
+    {
+	block4r (L::abs (s0), L::abs (s1), L::abs (s2), L::abs (s3));
+    }
+    inline void block4r (V t0, V t1, V t2, V t3) // rectified input
+    {
+	// x = |s| - z2 / 2, the z2 term is summed in _c4.
+	t0 = L::add (L::mul (_a3, t0), L::mul (_a2, t1));
+	t2 = L::add (L::mul (_a1, t2), t3);
+	_z1 = L::add (L::mul (_a4, _z1), L::sub (L::mul (_w1, L::add (t0, t2)), L::mul (_c4, _z2)));
+	end ();
+    }
+
+    inline void begin (void)
+    {
+	_t2 = L::mul (_z2, _half);
+    }
+    inline void step (V s) { stepr (L::abs (s)); }
+    inline void stepr (V t)
+    {
+	_z1 = L::add (_z1, L::mul (_w1, L::sub (L::sub (t, _t2), _z1)));
+    }
+    inline void end (void)
+    {
+	_z2 = L::add (_z2, L::mul (_w2, L::sub (_z1, _z2)));
+	_m  = L::max (_z2, _m);
+    }
+
+    const V _w1, _w2, _half, _a1, _a2, _a3, _a4, _c4;
+    V _z1, _z2, _m, _t2;
+};
+
+
+/* Run kernel K over n samples of S, U samples per loop iteration
+ * (a multiple of 4). ph is the number of samples already processed
+ * in the current sub-block, the new value is returned. A sub-block
+ * may thus span two calls and no samples are dropped, whatever n is.
+ * z2 and m are only updated at the end of a complete sub-block.
+ */
+template <int U, class K, class S>
+static inline int jmeter_run (K &k, const S &src, int n, int ph)
+{
+    typename K::V s0, s1, s2, s3;
+    int i = 0;
+
+    if (ph)
+    {
+	while (ph < 4 && i < n) { k.step (src.get1 (i++)); ++ph; }
+	if (ph < 4) return ph;
+	k.end ();
+    }
+
+    for (; i + U <= n; i += U)
+    {
+	for (int j = 0; j < U; j += 4)
+	{
+	    src.get4 (i + j, s0, s1, s2, s3);
+	    k.block4 (s0, s1, s2, s3);
+	}
+    }
+    for (; i + 4 <= n; i += 4)
+    {
+	src.get4 (i, s0, s1, s2, s3);
+	k.block4 (s0, s1, s2, s3);
+    }
+
+    ph = 0;
+    if (i < n)
+    {
+	k.begin ();
+	while (i < n) { k.step (src.get1 (i++)); ++ph; }
+    }
+    return ph;
+}
+
+};
+
+#endif
@@ -18,85 +18,74 @@
 */
 
 #include <math.h>
+#include "jmeterkernel.h"
 #include "kmeterdsp.h"
 
 namespace LV2M {
 
-float  Kmeterdsp::_omega;
-int    Kmeterdsp::_hold;
-float  Kmeterdsp::_fsamp;
-
-
 Kmeterdsp::Kmeterdsp (void) :
     _z1 (0),
     _z2 (0),
     _rms (0),
     _peak (0),
     _cnt (0),
+    _ph (0),
     _fpp (0),
     _fall (0),
-    _flag (false)
+    _flag (false),
+    _coef (0)
 {
 }
 
 
 Kmeterdsp::~Kmeterdsp (void)
 {
+    Jmetercoeff::destroy (_coef);
 }
 
 void Kmeterdsp::init (float fsamp)
 {
-    const float hold = 0.5f;
-    _fsamp = fsamp;
-
-    _hold = (int)(hold * fsamp + 0.5f); // number of samples to hold peak
-    _omega = 9.72f / fsamp; // ballistic filter coefficient
+    Jmetercoeff::destroy (_coef);
+    _coef = Jmetercoeff::create (Jmetercoeff::KMETER, fsamp);
 }
 
 void Kmeterdsp::process (float *p, int n)
+{
+    process (p, 0, n);
+}
+
+
+void Kmeterdsp::process (float *p, float *q, int n)
 {
     // Called by JACK's process callback.
     //
     // p : pointer to sample buffer
+    // q : if not 0, p is copied to q
     // n : number of samples to process
 
     float  s, t, z1, z2;
+    const float omega = _coef->_w1;
 
     if (_fpp != n) {
 	const float fall = 15.0f;
-	const float tme = (float) n / _fsamp; // period time in seconds
+	const float tme = (float) n / _coef->_fsamp; // period time in seconds
 	_fall = powf (10.0f, -0.05f * fall * tme); // per period fallback multiplier
 	_fpp = n;
     }
 
-    t = 0;
     // Get filter state.
     z1 = _z1 > 50 ? 50 : (_z1 < 0 ? 0 : _z1);
     z2 = _z2 > 50 ? 50 : (_z2 < 0 ? 0 : _z2);
 
     // Perform filtering. The second filter is evaluated
     // only every 4th sample - this is just an optimisation.
-    n /= 4;  // Loop is unrolled by 4.
-    while (n--)
-    {
-	s = *p++;
-	s *= s;
-	if (t < s) t = s;             // Update digital peak.
-	z1 += _omega * (s - z1);      // Update first filter.
-	s = *p++;
-	s *= s;
-	if (t < s) t = s;             // Update digital peak.
-	z1 += _omega * (s - z1);      // Update first filter.
-	s = *p++;
-	s *= s;
-	if (t < s) t = s;             // Update digital peak.
-	z1 += _omega * (s - z1);      // Update first filter.
-	s = *p++;
-	s *= s;
-	if (t < s) t = s;             // Update digital peak.
-	z1 += _omega * (s - z1);      // Update first filter.
-        z2 += 4 * _omega * (z1 - z2); // Update second filter.
-    }
+    // A sub-block of 4 samples may span two periods.
+    KmeterKernel<LaneFlt> k (omega, z1, z2);
+    if (q) _ph = jmeter_run<8> (k, SrcMonoCopy (p, q, n), n, _ph);
+    else   _ph = jmeter_run<8> (k, SrcMono (p), n, _ph);
+    z1 = k._z1;
+    z2 = k._z2;
+    t = k._t;
 
     if (isnan(z1)) z1 = 0;
     if (isnan(z2)) z2 = 0;
@@ -125,7 +114,7 @@ void Kmeterdsp::process (float *p, int n)
     {
 	// If higher than current value, update and set hold counter.
 	_peak = t;
-	_cnt = _hold;
+	_cnt = _coef->_hold;
     }
     else if (_cnt > 0)
     {
@@ -158,6 +147,7 @@ void Kmeterdsp::reset ()
 {
     _z1 = _z2 = _rms = _peak = .0f;
     _cnt = 0;
+    _ph = 0;
     _flag = false;
 }
 
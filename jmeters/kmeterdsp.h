@@ -19,6 +19,7 @@
 #define	__KMETERDSP_H
 
 #include "jmeterdsp.h"
+#include "jmetercoeff.h"
 
 namespace LV2M {
 
@@ -30,6 +31,7 @@ public:
     ~Kmeterdsp (void);
 
     void process (float *p, int n);
+    void process (float *p, float *q, int n); // and copy p to q
     float read (void);
     void read (float &rms, float &peak);
     void reset (void);
@@ -43,13 +45,12 @@ private:
 		float          _rms;         // max rms value since last read()
 		float          _peak;        // max peak value since last read()
 		int            _cnt;	       // digital peak hold counter
+		int            _ph;          // position in the current 4 sample sub-block
 		int            _fpp;	       // frames per period
 		float          _fall;        // peak fallback
 		bool           _flag;        // flag set by read(), resets _rms
 
-		static float   _omega;       // ballistics filter constant.
-		static int     _hold;        // peak hold timeoute
-		static float   _fsamp;       // sample-rate
+		const Jmetercoeff *_coef;    // ballistics filter constant, peak hold timeout
 
 };
 
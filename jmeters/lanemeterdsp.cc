@@ -0,0 +1,362 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <assert.h>
+#include "jmeterkernel.h"
+#include "lanemeterdsp.h"
+
+namespace LV2M {
+
+/* One group of L::N channels */
+template <class L, class S>
+static int run_group (Lanemeterdsp::Type type, const S &src, int n, int ph,
+		float *z1, float *z2, float *m, float w1, float w2, float w3)
+{
+    int rv = 0;
+    switch (type)
+    {
+	case Lanemeterdsp::KMETER:
+	    {
+		KmeterKernel<L> k (w1, L::load (z1), L::load (z2));
+		rv = jmeter_run<8> (k, src, n, ph);
+		L::store (z1, k._z1);
+		L::store (z2, k._z2);
+		L::store (m, k._t);
+	    }
+	    break;
+	case Lanemeterdsp::IEC1PPM:
+	case Lanemeterdsp::IEC2PPM:
+	    {
+		IecppmKernel<L> k (L::set1 (w1), L::set1 (w2), L::set1 (w3), L::load (z1), L::load (z2), L::load (m));
+		rv = jmeter_run<8> (k, src, n, ph);
+		L::store (z1, k._z1);
+		L::store (z2, k._z2);
+		L::store (m, k._m);
+	    }
+	    break;
+	case Lanemeterdsp::VUMETER:
+	    {
+		VumeterKernel<L> k (w1, L::load (z1), L::load (z2), L::load (m));
+		rv = jmeter_run<8> (k, src, n, ph);
+		L::store (z1, k._z1);
+		L::store (z2, k._z2);
+		L::store (m, k._m);
+	    }
+	    break;
+    }
+    return rv;
+}
+
+
+template <class L>
+static int run_lanes (Lanemeterdsp::Type type, float * const *p, float * const *q, int nchan, int n, int ph,
+		float *z1, float *z2, float *m, float w1, float w2, float w3)
+{
+    int rv = 0;
+    for (int c = 0; c < nchan; c += L::N)
+    {
+	if (q) rv = run_group<L> (type, SrcLanesCopy<L> (p + c, q + c, n), n, ph, z1 + c, z2 + c, m + c, w1, w2, w3);
+	else   rv = run_group<L> (type, SrcLanes<L> (p + c), n, ph, z1 + c, z2 + c, m + c, w1, w2, w3);
+    }
+    return rv;
+}
+
+
+/* lanes per group in run_lanes(), the channel count is padded to a multiple of it */
+#define LANEMETER_GROUP 8
+
+/* frames per block of Lanemeterdsp::copy() */
+#define LANEMETER_COPY 64
+
+
+Lanemeterdsp::Lanemeterdsp (void) :
+    _type (KMETER),
+    _nchan (0),
+    _nlane (0),
+    _ph (0),
+    _z1 (0),
+    _z2 (0),
+    _m (0),
+    _rms (0),
+    _peak (0),
+    _cnt (0),
+    _res (0),
+    _pp (0),
+    _qq (0),
+    _buf (0),
+    _fpp (0),
+    _fall (0),
+    _coef (0)
+{
+}
+
+
+Lanemeterdsp::~Lanemeterdsp (void)
+{
+    free (_z1);
+    free (_cnt);
+    free (_res);
+    free (_pp);
+    Jmetercoeff::destroy (_coef);
+}
+
+
+void Lanemeterdsp::init (Type type, int nchan, float fsamp)
+{
+    assert (nchan > 0);
+    _type = type;
+    _nchan = nchan;
+    _nlane = (nchan + LANEMETER_GROUP - 1) / LANEMETER_GROUP * LANEMETER_GROUP;
+    _fpp = 0;
+
+    // one contiguous block for the float state
+    free (_z1);
+    free (_cnt);
+    free (_res);
+    free (_pp);
+    _z1   = (float *) calloc (5 * _nlane + _nchan * LANEMETER_COPY, sizeof (float));
+    _z2   = _z1 + _nlane;
+    _m    = _z2 + _nlane;
+    _rms  = _m + _nlane;
+    _peak = _rms + _nlane;
+    _buf  = _peak + _nlane;
+    _cnt  = (int *) calloc (_nlane, sizeof (int));
+    _res  = (bool *) calloc (_nlane, sizeof (bool));
+    _pp   = (float **) calloc (2 * _nlane, sizeof (float *));
+    _qq   = _pp + _nlane;
+
+    Jmetercoeff::destroy (_coef);
+    switch (type)
+    {
+	case KMETER:  _coef = Jmetercoeff::create (Jmetercoeff::KMETER, fsamp); break;
+	case IEC1PPM: _coef = Jmetercoeff::create (Jmetercoeff::IEC1PPM, fsamp); break;
+	case IEC2PPM: _coef = Jmetercoeff::create (Jmetercoeff::IEC2PPM, fsamp); break;
+	case VUMETER: _coef = Jmetercoeff::create (Jmetercoeff::VUMETER, fsamp); break;
+    }
+    reset ();
+}
+
+
+void Lanemeterdsp::reset (void)
+{
+    for (int c = 0; c < _nlane; ++c)
+    {
+	_z1 [c] = _z2 [c] = _m [c] = 0;
+	_rms [c] = _peak [c] = 0;
+	_cnt [c] = 0;
+	_res [c] = (_type != KMETER);
+    }
+    _ph = 0;
+}
+
+
+void Lanemeterdsp::process (float * const *p, int n)
+{
+    process (p, 0, n);
+}
+
+
+void Lanemeterdsp::process (float * const *p, float * const *q, int n)
+{
+    float lo, hi;
+    int   c, j;
+    bool  alias = false;
+
+    // Padding lanes re-process (and copy) the last channel, results are discarded.
+    for (c = 0; c < _nlane; ++c) _pp [c] = p [c < _nchan ? c : _nchan - 1];
+    if (q) for (c = 0; c < _nlane; ++c) _qq [c] = q [c < _nchan ? c : _nchan - 1];
+
+    // The fused copy writes a channel before the next one is read. If an
+    // output overlaps another channel's input, meter first, then copy.
+    for (c = 0; q && c < _nchan; ++c)
+    {
+	if (q [c] == p [c]) continue;
+	for (j = 0; j < _nchan; ++j)
+	{
+	    if (q [c] < p [j] + n && p [j] < q [c] + n) alias = true;
+	}
+    }
+
+    if (_type == KMETER) { lo = 0; hi = 50; }
+    else if (_type == VUMETER) { lo = -20; hi = 20; }
+    else { lo = 0; hi = 20; }
+
+    for (c = 0; c < _nlane; ++c)
+    {
+	_z1 [c] = _z1 [c] > hi ? hi : (_z1 [c] < lo ? lo : _z1 [c]);
+	_z2 [c] = _z2 [c] > hi ? hi : (_z2 [c] < lo ? lo : _z2 [c]);
+	if (_type != KMETER)
+	{
+	    if (_res [c]) _m [c] = 0;
+	    _res [c] = false;
+	}
+    }
+
+    const float w1 = _coef->_w1;
+    const float w2 = _coef->_w2;
+    const float w3 = _coef->_w3;
+
+#ifdef __AVX__
+    if (_nchan > 4) _ph = run_lanes<LaneAVX> (_type, _pp, (q && !alias) ? _qq : 0, _nchan, n, _ph, _z1, _z2, _m, w1, w2, w3);
+    else
+#endif
+#ifdef __SSE__
+    _ph = run_lanes<LaneSSE> (_type, _pp, (q && !alias) ? _qq : 0, _nchan, n, _ph, _z1, _z2, _m, w1, w2, w3);
+#else
+    _ph = run_lanes<LaneFlt> (_type, _pp, (q && !alias) ? _qq : 0, _nchan, n, _ph, _z1, _z2, _m, w1, w2, w3);
+#endif
+    if (alias) copy (p, q, n);
+
+    switch (_type)
+    {
+	case KMETER:
+	    fini_kmeter (n);
+	    break;
+	case IEC1PPM:
+	case IEC2PPM:
+	    fini_iec ();
+	    break;
+	case VUMETER:
+	    fini_vu ();
+	    break;
+    }
+}
+
+
+void Lanemeterdsp::copy (float * const *p, float * const *q, int n)
+{
+    int c, j, k;
+
+    // All inputs of a block are read before any output is written.
+    for (j = 0; j < n; j += k)
+    {
+	k = (n - j < LANEMETER_COPY) ? n - j : LANEMETER_COPY;
+	for (c = 0; c < _nchan; ++c) jmeter_copy (p [c] + j, _buf + c * LANEMETER_COPY, k);
+	for (c = 0; c < _nchan; ++c) jmeter_copy (_buf + c * LANEMETER_COPY, q [c] + j, k);
+    }
+}
+
+
+void Lanemeterdsp::fini_kmeter (int n)
+{
+    if (_fpp != n)
+    {
+	const float fall = 15.0f;
+	const float tme = (float) n / _coef->_fsamp; // period time in seconds
+	_fall = powf (10.0f, -0.05f * fall * tme); // per period fallback multiplier
+	_fpp = n;
+    }
+
+    for (int c = 0; c < _nchan; ++c)
+    {
+	float s, t;
+	if (isnan (_z1 [c])) _z1 [c] = 0;
+	if (isnan (_z2 [c])) _z2 [c] = 0;
+	t = _m [c];
+	if (!isfinite (t)) t = 0;
+
+	// The added constants avoid denormals.
+	_z1 [c] += 1e-20f;
+	_z2 [c] += 1e-20f;
+
+	s = sqrtf (2.0f * _z2 [c]);
+	t = sqrtf (t);
+
+	if (_res [c]) // Display thread has read the rms value.
+	{
+	    _rms [c] = s;
+	    _res [c] = false;
+	}
+	else if (s > _rms [c])
+	{
+	    _rms [c] = s;
+	}
+
+	// Digital peak hold and fallback.
+	if (t >= _peak [c])
+	{
+	    _peak [c] = t;
+	    _cnt [c] = _coef->_hold;
+	}
+	else if (_cnt [c] > 0)
+	{
+	    _cnt [c] -= _fpp;
+	}
+	else
+	{
+	    _peak [c] *= _fall;
+	    _peak [c] += 1e-10f;
+	}
+    }
+}
+
+
+void Lanemeterdsp::fini_iec (void)
+{
+    for (int c = 0; c < _nchan; ++c)
+    {
+	_z1 [c] += 1e-10f;
+	_z2 [c] += 1e-10f;
+    }
+}
+
+
+void Lanemeterdsp::fini_vu (void)
+{
+    for (int c = 0; c < _nchan; ++c)
+    {
+	if (!isfinite (_z1 [c])) { _z1 [c] = 0; _m [c] = INFINITY; }
+	if (!isfinite (_z2 [c])) { _z2 [c] = 0; _m [c] = INFINITY; } else _z2 [c] += 1e-10f;
+    }
+}
+
+
+float Lanemeterdsp::read (int c)
+{
+    if (_type == KMETER)
+    {
+	_res [c] = true; // Resets _rms in next process().
+	return _rms [c];
+    }
+    _res [c] = true;
+    return _coef->_g * _m [c];
+}
+
+
+void Lanemeterdsp::read (int c, float &rms, float &peak)
+{
+    rms  = _rms [c];
+    peak = _peak [c];
+    _res [c] = true; // Resets _rms in next process().
+}
+
+
+void Lanemeterdsp::read (float *v)
+{
+    for (int c = 0; c < _nchan; ++c) v [c] = read (c);
+}
+
+
+void Lanemeterdsp::read (float *rms, float *peak)
+{
+    for (int c = 0; c < _nchan; ++c) read (c, rms [c], peak [c]);
+}
+
+};
+/* vi:set ts=8 sts=8 sw=4: */
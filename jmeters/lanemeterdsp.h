@@ -0,0 +1,95 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __LANEMETERDSP_H
+#define	__LANEMETERDSP_H
+
+#include "jmetercoeff.h"
+
+namespace LV2M {
+
+/* Multi-channel ballistics engine, a pool of any number of meters
+ * of the same type.
+ *
+ * Same filters as Kmeterdsp, Iec1ppmdsp, Iec2ppmdsp and Vumeterdsp,
+ * but the state of all channels is kept in contiguous arrays
+ * (structure of arrays), one channel per SIMD lane: 4 (SSE) or
+ * 8 (AVX) channels are processed per instruction. Meant for hosts
+ * that meter many ports, e.g. all strips of a mixer, with a single
+ * process() call per period.
+ */
+class Lanemeterdsp
+{
+public:
+
+    enum Type {
+	KMETER = 0,
+	IEC1PPM,
+	IEC2PPM,
+	VUMETER
+    };
+
+    Lanemeterdsp (void);
+    ~Lanemeterdsp (void);
+
+    void init (Type type, int nchan, float fsamp); // allocates, not realtime safe
+    void process (float * const *p, int n);
+    void process (float * const *p, float * const *q, int n); // and copy p to q
+    float read (int c);
+    void read (int c, float &rms, float &peak); // KMETER only
+    void read (float *v);                        // all channels, v [nchan]
+    void read (float *rms, float *peak);         // all channels, KMETER only
+    void reset (void);
+
+    int nchan (void) const { return _nchan; }
+
+private:
+
+    Lanemeterdsp (const Lanemeterdsp&);
+    Lanemeterdsp& operator= (const Lanemeterdsp&);
+
+    void fini_kmeter (int n);
+    void fini_iec (void);
+    void fini_vu (void);
+    void copy (float * const *p, float * const *q, int n);
+
+    Type           _type;
+    int            _nchan;
+    int            _nlane;       // _nchan rounded up to a multiple of the SIMD width
+    int            _ph;          // position in the current 4 sample sub-block
+
+    // per channel state [_nlane]
+    float         *_z1;          // filter state
+    float         *_z2;          // filter state
+    float         *_m;           // max value since last read(), K-meter: digital peak of last period
+    float         *_rms;         // K-meter max rms value since last read()
+    float         *_peak;        // K-meter max peak value since last read()
+    int           *_cnt;         // K-meter digital peak hold counter
+    bool          *_res;         // flag to reset m, K-meter: reset _rms
+    float        **_pp;          // input and output pointers, padded to _nlane
+    float        **_qq;
+    float         *_buf;         // [_nchan * LANEMETER_COPY], copy if an output aliases an input
+
+    int            _fpp;         // frames per period
+    float          _fall;        // peak fallback
+
+    const Jmetercoeff *_coef;    // ballistics
+};
+
+};
+
+#endif
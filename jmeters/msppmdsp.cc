@@ -21,116 +21,84 @@
 
 
 #include <math.h>
+#include "jmeterkernel.h"
 #include "msppmdsp.h"
 
 namespace LV2M {
 
-float  Msppmdsp::_w1 = 0;
-float  Msppmdsp::_w2 = 0;
-float  Msppmdsp::_w3 = 0;
-float  Msppmdsp::_g = 0; 
-
-
 Msppmdsp::Msppmdsp (float mdb) :
     _z1 (0),
     _z2 (0),
     _m (0),
     _res (true),
+    _ph (0),
     _db (0),
-    _mv (1.0)
+    _mv (1.0),
+    _coef (0)
 {
     set_gain (mdb);
 }
 
 Msppmdsp::~Msppmdsp (void)
 {
+    Jmetercoeff::destroy (_coef);
 }
 
 
-void Msppmdsp::processM (float *pl, float *pr, int n)
+void Msppmdsp::processM (float *pl, float *pr, int n, float *ql, float *qr)
 {
-    float z1, z2, m, t;
+    float z1, z2, m;
+    const float w1 = _coef->_w1;
+    const float w2 = _coef->_w2;
+    const float w3 = _coef->_w3;
 
     z1 = _z1 > 20 ? 20 : (_z1 < 0 ? 0 : _z1);
     z2 = _z2 > 20 ? 20 : (_z2 < 0 ? 0 : _z2);
     m = _res ? 0: _m;
     _res = false;
 
-    n /= 4;
-    while (n--)
-    {
-	z1 *= _w3;
-	z2 *= _w3;
-	t = _mv * fabsf (*pl++ + *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ + *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ + *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ + *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = z1 + z2;
-	if (t > m) m = t;
-    }
+    IecppmKernel<LaneFlt> k (w1, w2, w3, z1, z2, m);
+    if (ql) _ph = jmeter_run<8> (k, SrcMS<false, true> (pl, pr, _mv, ql, qr, n), n, _ph);
+    else    _ph = jmeter_run<8> (k, SrcMS<false> (pl, pr, _mv), n, _ph);
 
-    _z1 = z1 + 1e-10f;
-    _z2 = z2 + 1e-10f;
-    _m = m;
+    _z1 = k._z1 + 1e-10f;
+    _z2 = k._z2 + 1e-10f;
+    _m = k._m;
 }
 
-void Msppmdsp::processS (float *pl, float *pr, int n)
+void Msppmdsp::processS (float *pl, float *pr, int n, float *ql, float *qr)
 {
-    float z1, z2, m, t;
+    float z1, z2, m;
+    const float w1 = _coef->_w1;
+    const float w2 = _coef->_w2;
+    const float w3 = _coef->_w3;
 
     z1 = _z1 > 20 ? 20 : (_z1 < 0 ? 0 : _z1);
     z2 = _z2 > 20 ? 20 : (_z2 < 0 ? 0 : _z2);
     m = _res ? 0: _m;
     _res = false;
 
-    n /= 4;
-    while (n--)
-    {
-	z1 *= _w3;
-	z2 *= _w3;
-	t = _mv * fabsf (*pl++ - *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ - *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ - *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = _mv * fabsf (*pl++ - *pr++);
-	if (t > z1) z1 += _w1 * (t - z1);
-	if (t > z2) z2 += _w2 * (t - z2);
-	t = z1 + z2;
-	if (t > m) m = t;
-    }
+    IecppmKernel<LaneFlt> k (w1, w2, w3, z1, z2, m);
+    if (ql) _ph = jmeter_run<8> (k, SrcMS<true, true> (pl, pr, _mv, ql, qr, n), n, _ph);
+    else    _ph = jmeter_run<8> (k, SrcMS<true> (pl, pr, _mv), n, _ph);
 
-    _z1 = z1 + 1e-10f;
-    _z2 = z2 + 1e-10f;
-    _m = m;
+    _z1 = k._z1 + 1e-10f;
+    _z2 = k._z2 + 1e-10f;
+    _m = k._m;
 }
 
 
 float Msppmdsp::read (void)
 {
     _res = true;
-    return _g * _m;
+    return _coef->_g * _m;
 }
 
 
 void Msppmdsp::init (float fsamp)
 {
-    _w1 = 200.0f / fsamp;
-    _w2 = 860.0f / fsamp;
-    _w3 = 1.0f - 4.0f / fsamp;
-    _g = 0.5141f;
+    Jmetercoeff::destroy (_coef);
+    _coef = Jmetercoeff::create (Jmetercoeff::IEC2PPM, fsamp);
 }
 
 
@@ -23,6 +23,8 @@
 #ifndef __MSPPMDSP_H
 #define	__MSPPMDSP_H
 
+#include "jmetercoeff.h"
+
 namespace LV2M {
 
 class Msppmdsp
@@ -32,12 +34,13 @@ public:
     Msppmdsp (float mdb);
     ~Msppmdsp (void);
 
-    void processM (float *pl, float *pr, int n);  
-    void processS (float *pl, float *pr, int n);  
+    // if ql is not 0, pl and pr are copied to ql and qr
+    void processM (float *pl, float *pr, int n, float *ql = 0, float *qr = 0);
+    void processS (float *pl, float *pr, int n, float *ql = 0, float *qr = 0);
     float read (void);
     void set_gain (float);
 
-    static void init (float fsamp); 
+    void init (float fsamp);
 
 private:
 
@@ -45,13 +48,11 @@ private:
     float          _z2;          // filter state
     float          _m;           // max value since last read()
     bool           _res;         // flag to reset m
+    int            _ph;          // position in the current 4 sample sub-block
     float          _db;          // dB offset m3, m6
     float          _mv;          // gain-coeff
 
-    static float   _w1;          // attack filter coefficient
-    static float   _w2;          // attack filter coefficient
-    static float   _w3;          // release filter coefficient
-    static float   _g;           // gain factor
+    const Jmetercoeff *_coef;    // attack/release filter coefficients, gain factor
 };
 
 };
@@ -20,46 +20,160 @@
 
 
 #include <math.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "stcorrdsp.h"
 
 namespace LV2M {
 
-float  Stcorrdsp::_w1;
-float  Stcorrdsp::_w2; 
-
+#ifdef __SSE2__
+// Block formulation, 4 samples per step, lane k holds sample 4m + k.
+//
+// The lowpass  z += w (x - z)  unrolled over 4 samples, with a = 1 - w:
+//
+//   z_k = a^4 z_k-4 + w (x_k + a x_k-1 + a^2 x_k-2 + a^3 x_k-3)
+//
+// so every lane only depends on the same lane of the previous step.
+// The x_k-j are unaligned loads. The first step of a period has no
+// previous input, it is  z_k = a^(k+1) z_-1 + w (...)  with x_j = 0
+// for j < 0.
+//
+// The correlation filters are only read at the end of the period.
+// Lane k sums the products of phase k:  A = b^4 A + w p  and the
+// filter output is  b^3 A_0 + b^2 A_1 + b A_2 + A_3.
 
+static inline void corr_step (__m128 l, __m128 r, __m128 &zlr, __m128 &zll, __m128 &zrr, __m128 w2, __m128 b4)
+{
+    const __m128 wl = _mm_mul_ps (w2, l);
+    zlr = _mm_add_ps (_mm_mul_ps (b4, zlr), _mm_mul_ps (wl, r));
+    zll = _mm_add_ps (_mm_mul_ps (b4, zll), _mm_mul_ps (wl, l));
+    zrr = _mm_add_ps (_mm_mul_ps (b4, zrr), _mm_mul_ps (_mm_mul_ps (w2, r), r));
+}
+#endif
 
 Stcorrdsp::Stcorrdsp (void) :
     _zl (0),
     _zr (0),
     _zlr (0),
     _zll (0),
-    _zrr (0)
+    _zrr (0),
+    _coef (0)
 {
 }
 
 
 Stcorrdsp::~Stcorrdsp (void)
 {
+    Jmetercoeff::destroy (_coef);
 }
 
 
-void Stcorrdsp::process (float *pl, float *pr, int n)
+void Stcorrdsp::process (float *pl, float *pr, int n, float *ql, float *qr)
 {
     float zl, zr, zlr, zll, zrr;
+    const float w1 = _coef->_w1;
+    const float w2 = _coef->_w2;
 
     zl = _zl;
     zr = _zr;
     zlr = _zlr;
     zll = _zll;
     zrr = _zrr;
+
+#ifdef __SSE2__
+    if (n >= 4)
+    {
+	const float a1 = 1 - w1;
+	const float b1 = 1 - w2;
+	const __m128 va1 = _mm_set1_ps (a1);
+	const __m128 va2 = _mm_set1_ps (a1 * a1);
+	const __m128 va3 = _mm_set1_ps (a1 * a1 * a1);
+	const __m128 va4 = _mm_set1_ps (a1 * a1 * a1 * a1);
+	const __m128 vb4 = _mm_set1_ps (b1 * b1 * b1 * b1);
+	const __m128 vw1 = _mm_set1_ps (w1);
+	const __m128 vw2 = _mm_set1_ps (w2);
+	const __m128 vak = _mm_setr_ps (a1, a1 * a1, a1 * a1 * a1, a1 * a1 * a1 * a1);
+
+	__m128 vl, vr;
+	__m128 vlr = _mm_setr_ps (0, 0, 0, zlr);
+	__m128 vll = _mm_setr_ps (0, 0, 0, zll);
+	__m128 vrr = _mm_setr_ps (0, 0, 0, zrr);
+
+	// first step, no previous input
+	__m128 l = _mm_loadu_ps (pl);
+	__m128 r = _mm_loadu_ps (pr);
+	__m128 ul = _mm_add_ps (l, _mm_mul_ps (va1, _mm_setr_ps (0, pl [0], pl [1], pl [2])));
+	__m128 ur = _mm_add_ps (r, _mm_mul_ps (va1, _mm_setr_ps (0, pr [0], pr [1], pr [2])));
+	ul = _mm_add_ps (ul, _mm_mul_ps (va2, _mm_setr_ps (0, 0, pl [0], pl [1])));
+	ur = _mm_add_ps (ur, _mm_mul_ps (va2, _mm_setr_ps (0, 0, pr [0], pr [1])));
+	ul = _mm_add_ps (ul, _mm_mul_ps (va3, _mm_setr_ps (0, 0, 0, pl [0])));
+	ur = _mm_add_ps (ur, _mm_mul_ps (va3, _mm_setr_ps (0, 0, 0, pr [0])));
+
+	vl = _mm_add_ps (_mm_mul_ps (vak, _mm_set1_ps (zl)), _mm_mul_ps (vw1, ul));
+	vr = _mm_add_ps (_mm_mul_ps (vak, _mm_set1_ps (zr)), _mm_mul_ps (vw1, ur));
+	corr_step (vl, vr, vlr, vll, vrr, vw2, vb4);
+
+	int i;
+	for (i = 4; i + 4 <= n; i += 4)
+	{
+	    l = _mm_loadu_ps (pl + i);
+	    r = _mm_loadu_ps (pr + i);
+	    ul = _mm_add_ps (l,  _mm_mul_ps (va1, _mm_loadu_ps (pl + i - 1)));
+	    ur = _mm_add_ps (r,  _mm_mul_ps (va1, _mm_loadu_ps (pr + i - 1)));
+	    ul = _mm_add_ps (ul, _mm_mul_ps (va2, _mm_loadu_ps (pl + i - 2)));
+	    ur = _mm_add_ps (ur, _mm_mul_ps (va2, _mm_loadu_ps (pr + i - 2)));
+	    ul = _mm_add_ps (ul, _mm_mul_ps (va3, _mm_loadu_ps (pl + i - 3)));
+	    ur = _mm_add_ps (ur, _mm_mul_ps (va3, _mm_loadu_ps (pr + i - 3)));
+	    vl = _mm_add_ps (_mm_mul_ps (va4, vl), _mm_mul_ps (vw1, ul));
+	    vr = _mm_add_ps (_mm_mul_ps (va4, vr), _mm_mul_ps (vw1, ur));
+	    corr_step (vl, vr, vlr, vll, vrr, vw2, vb4);
+	}
+
+	const __m128 bk = _mm_setr_ps (b1 * b1 * b1, b1 * b1, b1, 1);
+	float t [4];
+	zl = _mm_cvtss_f32 (_mm_shuffle_ps (vl, vl, _MM_SHUFFLE (3, 3, 3, 3)));
+	zr = _mm_cvtss_f32 (_mm_shuffle_ps (vr, vr, _MM_SHUFFLE (3, 3, 3, 3)));
+	_mm_storeu_ps (t, _mm_mul_ps (bk, vlr)); zlr = (t [0] + t [1]) + (t [2] + t [3]);
+	_mm_storeu_ps (t, _mm_mul_ps (bk, vll)); zll = (t [0] + t [1]) + (t [2] + t [3]);
+	_mm_storeu_ps (t, _mm_mul_ps (bk, vrr)); zrr = (t [0] + t [1]) + (t [2] + t [3]);
+
+	// Copy after metering, the shifted loads read up to 3 samples
+	// back and ql may alias pr. Each l, r pair is read before it is
+	// stored.
+	for (int j = 0; ql && j < i; j += 4)
+	{
+	    l = _mm_loadu_ps (pl + j);
+	    r = _mm_loadu_ps (pr + j);
+	    _mm_storeu_ps (ql + j, l);
+	    _mm_storeu_ps (qr + j, r);
+	}
+
+	pl += i;
+	pr += i;
+	if (ql)
+	{
+	    ql += i;
+	    qr += i;
+	}
+	n -= i;
+    }
+#endif
+
     while (n--)
     {
-	zl += _w1 * (*pl++ - zl) + 1e-20f;
-	zr += _w1 * (*pr++ - zr) + 1e-20f;
-	zlr += _w2 * (zl * zr - zlr);
-	zll += _w2 * (zl * zl - zll);
-	zrr += _w2 * (zr * zr - zrr);
+	const float l = *pl++;
+	const float r = *pr++;
+	if (ql)
+	{
+	    *ql++ = l;
+	    *qr++ = r;
+	}
+	zl += w1 * (l - zl);
+	zr += w1 * (r - zr);
+	zlr += w2 * (zl * zr - zlr);
+	zll += w2 * (zl * zl - zll);
+	zrr += w2 * (zr * zr - zrr);
     }
 
     if (!isfinite(zl)) zl = 0;
@@ -88,8 +202,8 @@ void Stcorrdsp::init (int fsamp, float flp, float tcf)
     // flp   = lowpass frequency
     // tcf   = correlation filter time constant
 
-    _w1 = 6.28f * flp / fsamp;
-    _w2 = 1 / (tcf * fsamp);
+    Jmetercoeff::destroy (_coef);
+    _coef = Jmetercoeff::create (Jmetercoeff::STCORR, fsamp, flp, tcf);
 }
 
 }
@@ -22,6 +22,8 @@
 #ifndef __STCORRDSP_H
 #define	__STCORRDSP_H
 
+#include "jmetercoeff.h"
+
 namespace LV2M {
 
 class Stcorrdsp
@@ -31,10 +33,12 @@ public:
     Stcorrdsp (void);
     ~Stcorrdsp (void);
 
-    void process (float *pl, float *pr, int n);  
+    // if ql is not 0, pl and pr are copied to ql and qr
+    // the caller must flush denormals, see DenormalGuard
+    void process (float *pl, float *pr, int n, float *ql = 0, float *qr = 0);
     float read (void);
 
-    static void init (int fsamp, float flp, float tcf); 
+    void init (int fsamp, float flp, float tcf);
 
 private:
 
@@ -44,8 +48,7 @@ private:
     float          _zll;
     float          _zrr;
 
-    static float   _w1;          // lowpass filter coefficient
-    static float   _w2;          // correlation filter coeffient
+    const Jmetercoeff *_coef;    // lowpass and correlation filter coeffients
 };
 
 };
@@ -0,0 +1,369 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <pthread.h>
+#include "jmeterkernel.h"
+#include "tpoversampler.h"
+
+namespace LV2M {
+
+#if defined __AVX__
+typedef LaneAVX TpLane;
+#elif defined __SSE__
+typedef LaneSSE TpLane;
+#else
+typedef LaneFlt TpLane;
+#endif
+
+
+/* Coefficients in lane order. They depend on nothing but the SIMD width,
+ * so all instances share one copy, set up by the first init().
+ */
+static struct
+{
+    float  cv [TPOVS_NT * 3 * TpLane::N] __attribute__ ((aligned (32)));
+    float  c1 [TPOVS_NT * 3];
+    float  gv [TPOVS_HB * TpLane::N] __attribute__ ((aligned (32)));
+    float  g1 [TPOVS_HB];
+    float  gain;
+} tpovs_coeff;
+
+static pthread_once_t tpovs_once = PTHREAD_ONCE_INIT;
+
+
+/* Filter n samples at a stride of s floats (the channel count):
+ * output o uses x [o + i * s], i < TPOVS_NT, phase ph goes to y [ph - 1][o].
+ * Two groups of L::N samples per iteration: six independent sums
+ * hide the add latency, and every coefficient load is used twice.
+ * Returns the number of samples processed, a multiple of L::N.
+ */
+template <class L>
+static int tpovs_run (const float *x, const float *c, float *y1, float *y2, float *y3, int s, int n)
+{
+    typedef typename L::V V;
+    const int N = L::N;
+    int j = 0;
+
+    for (; j + 2 * N <= n; j += 2 * N)
+    {
+	V a1 = L::set1 (0), a2 = L::set1 (0), a3 = L::set1 (0);
+	V b1 = L::set1 (0), b2 = L::set1 (0), b3 = L::set1 (0);
+	const float *p = x + j;
+	const float *k = c;
+	for (int i = 0; i < TPOVS_NT; ++i, p += s, k += 3 * N)
+	{
+	    const V u = L::load (p);
+	    const V v = L::load (p + N);
+	    V h;
+	    h = L::load (k);
+	    a1 = L::add (a1, L::mul (u, h));
+	    b1 = L::add (b1, L::mul (v, h));
+	    h = L::load (k + N);
+	    a2 = L::add (a2, L::mul (u, h));
+	    b2 = L::add (b2, L::mul (v, h));
+	    h = L::load (k + 2 * N);
+	    a3 = L::add (a3, L::mul (u, h));
+	    b3 = L::add (b3, L::mul (v, h));
+	}
+	L::store (y1 + j, a1);
+	L::store (y2 + j, a2);
+	L::store (y3 + j, a3);
+	L::store (y1 + j + N, b1);
+	L::store (y2 + j + N, b2);
+	L::store (y3 + j + N, b3);
+    }
+
+    for (; j + N <= n; j += N)
+    {
+	V a1 = L::set1 (0), a2 = L::set1 (0), a3 = L::set1 (0);
+	const float *p = x + j;
+	const float *k = c;
+	for (int i = 0; i < TPOVS_NT; ++i, p += s, k += 3 * N)
+	{
+	    const V u = L::load (p);
+	    a1 = L::add (a1, L::mul (u, L::load (k)));
+	    a2 = L::add (a2, L::mul (u, L::load (k + N)));
+	    a3 = L::add (a3, L::mul (u, L::load (k + 2 * N)));
+	}
+	L::store (y1 + j, a1);
+	L::store (y2 + j, a2);
+	L::store (y3 + j, a3);
+    }
+    return j;
+}
+
+
+/* Halfband odd phase of samples j0 .. n - 1 (flat, all channels):
+ *   w [o] = sum g [j] * (a [j][o] + b [j][o]), j < TPOVS_HB
+ * Returns the number of samples processed.
+ */
+template <class L>
+static int tpovs_half (const float * const *a, const float * const *b, const float *g, float *w, int j0, int n)
+{
+    typedef typename L::V V;
+    const int N = L::N;
+    int o = j0;
+
+    for (; o + 2 * N <= n; o += 2 * N)
+    {
+	V s = L::set1 (0), t = L::set1 (0);
+	for (int j = 0; j < TPOVS_HB; ++j)
+	{
+	    const V h = L::load (g + j * N);
+	    s = L::add (s, L::mul (h, L::add (L::load (a [j] + o), L::load (b [j] + o))));
+	    t = L::add (t, L::mul (h, L::add (L::load (a [j] + o + N), L::load (b [j] + o + N))));
+	}
+	L::store (w + o, s);
+	L::store (w + o + N, t);
+    }
+
+    for (; o + N <= n; o += N)
+    {
+	V s = L::set1 (0);
+	for (int j = 0; j < TPOVS_HB; ++j)
+	{
+	    s = L::add (s, L::mul (L::load (g + j * N), L::add (L::load (a [j] + o), L::load (b [j] + o))));
+	}
+	L::store (w + o, s);
+    }
+    return o;
+}
+
+
+Tpoversampler::Tpoversampler (void) :
+    _nchan (0),
+    _factor (4),
+    _chunk (0),
+    _cap (0),
+    _len (0),
+    _n (0),
+    _nr (0),
+    _gain (1),
+    _mem (0),
+    _cv (0),
+    _c1 (0),
+    _gv (0),
+    _g1 (0),
+    _y (0),
+    _x (0)
+{
+}
+
+
+Tpoversampler::~Tpoversampler (void)
+{
+    free (_mem);
+}
+
+
+void Tpoversampler::init_coeff (void)
+{
+    const int N = TpLane::N;
+
+    /* Resampler::process() computes phase ph from the 2 * hl most recent
+     * samples w [0] (oldest) .. w [2 * hl - 1] as
+     *   sum (w [i] * c [ph][i] + w [2 * hl - 1 - i] * c [4 - ph][i]), i < hl
+     * with c [j] the table row j. Collect both halves per tap.
+     */
+    Resampler_table *T = Resampler_table::create (1.0, TPOVS_HL, 4);
+    const float *c = T->_ctab;
+    for (int i = 0; i < TPOVS_NT; ++i)
+    {
+	for (int ph = 1; ph < 4; ++ph)
+	{
+	    const float h = (i < TPOVS_HL)
+		? c [ph * TPOVS_HL + i]
+		: c [(4 - ph) * TPOVS_HL + TPOVS_NT - 1 - i];
+	    tpovs_coeff.c1 [3 * i + ph - 1] = h;
+	    for (int l = 0; l < N; ++l) tpovs_coeff.cv [(3 * i + ph - 1) * N + l] = h;
+	}
+    }
+
+    /* Halfband, table row 1 (t = 0.5): g [j] weighs the samples j before
+     * and j after the interpolated point.
+     */
+    Resampler_table *H = Resampler_table::create (1.0, TPOVS_HB, 2);
+    c = H->_ctab;
+    for (int j = 0; j < TPOVS_HB; ++j)
+    {
+	tpovs_coeff.g1 [j] = c [2 * TPOVS_HB - 1 - j];
+	for (int l = 0; l < N; ++l) tpovs_coeff.gv [j * N + l] = tpovs_coeff.g1 [j];
+    }
+
+    /* |y| <= sum |h| * max |x| per phase (phase 0 is the input). The
+     * margin covers the rounding of the float dot products.
+     */
+    double g = 1;
+    for (int ph = 1; ph < 4; ++ph)
+    {
+	double a = 0;
+	for (int i = 0; i < TPOVS_NT; ++i) a += fabs (tpovs_coeff.c1 [3 * i + ph - 1]);
+	if (a > g) g = a;
+    }
+    tpovs_coeff.gain = g * (1 + 1e-4);
+
+    Resampler_table::destroy (T);
+    Resampler_table::destroy (H);
+}
+
+
+void Tpoversampler::init (int nchan, int factor)
+{
+    assert (nchan > 0);
+    assert (factor == 4 || factor == 8 || factor == 16);
+    _nchan = nchan;
+    _factor = factor;
+    _chunk = nchan < TPOVS_CHUNK ? TPOVS_CHUNK / nchan : 1;
+    _cap = _chunk * nchan;
+    _len = (TPOVS_PRE + _chunk) * nchan;
+
+    pthread_once (&tpovs_once, init_coeff);
+    _cv = tpovs_coeff.cv;
+    _c1 = tpovs_coeff.c1;
+    _gv = tpovs_coeff.gv;
+    _g1 = tpovs_coeff.g1;
+    _gain = tpovs_coeff.gain;
+
+    // history and phase buffers only, reset () clears what is read
+    free (_mem);
+    _mem = (float *) malloc (((factor - 1) * _len + (TPOVS_NT - 1) * nchan + _cap) * sizeof (float));
+    _y = _mem;
+    _x = _y + (factor - 1) * _len;
+
+    const float *o4 [4], *o8 [8];
+    o4 [0] = _x + (TPOVS_HL - 1) * nchan;
+    for (int ph = 1; ph < 4; ++ph) o4 [ph] = _y + (ph - 1) * _len + TPOVS_PRE * nchan;
+    switch (factor)
+    {
+	case 4:
+	    for (int ph = 0; ph < 4; ++ph) _out [ph] = o4 [ph];
+	    break;
+	case 8:
+	    stage (o4, 4, 0, _out);
+	    break;
+	case 16:
+	    stage (o4, 4, 0, o8);
+	    stage (o8, 8, 4, _out);
+	    break;
+    }
+
+    reset ();
+}
+
+
+/* Set up a 2x halfband stage from r to 2 * r phases (rows row .. row + r - 1).
+ * Odd output phase k sits between input phases k and k + 1 (phase r being
+ * phase 0 of the next frame). The output is delayed by d frames, so that
+ * the last sample it needs is in the current chunk.
+ */
+void Tpoversampler::stage (const float * const *inp, int r, int row, const float **out)
+{
+    const int s = _nchan;
+    const int d = (r - 1 + TPOVS_HB) / r;
+
+    for (int k = 0; k < r; ++k)
+    {
+	for (int j = 0; j < TPOVS_HB; ++j)
+	{
+	    int t, ph;
+	    t = k - j;
+	    ph = (t % r + r) % r;
+	    _ha [row + k][j] = inp [ph] + ((t - ph) / r - d) * s;
+	    t = k + 1 + j;
+	    ph = t % r;
+	    _hb [row + k][j] = inp [ph] + ((t - ph) / r - d) * s;
+	}
+	_hw [row + k] = _y + (r - 1 + k) * _len + TPOVS_PRE * s;
+	out [2 * k]     = inp [k] - d * s;
+	out [2 * k + 1] = _hw [row + k];
+    }
+}
+
+
+void Tpoversampler::reset (void)
+{
+    memset (_y, 0, (_factor - 1) * _len * sizeof (float));
+    memset (_x, 0, (TPOVS_NT - 1) * _nchan * sizeof (float));
+    _n = 0;
+    _nr = 0;
+}
+
+
+void Tpoversampler::load (const float * const *p, int i, int n)
+{
+    assert (n <= _chunk);
+    const int s = _nchan;
+
+    // drop the previous input, it was kept for out (0) and inp ()
+    memmove (_x, _x + _n * s, (TPOVS_NT - 1) * s * sizeof (float));
+    _n = n;
+
+    float *x = _x + (TPOVS_NT - 1) * s;
+    if (s == 1)
+    {
+	memcpy (x, p [0] + i, n * sizeof (float));
+    }
+    else
+    {
+	for (int c = 0; c < s; ++c)
+	{
+	    const float *pc = p [c] + i;
+	    for (int j = 0; j < n; ++j) x [j * s + c] = pc [j];
+	}
+    }
+}
+
+
+void Tpoversampler::run (void)
+{
+    const int s = _nchan;
+    const int n = _n * s;
+
+    // keep TPOVS_PRE frames of the computed phases for the halfband stages
+    if (_factor > 4)
+    {
+	for (int b = 0; b < _factor - 1; ++b)
+	{
+	    float *y = _y + b * _len;
+	    memmove (y, y + _nr * s, TPOVS_PRE * s * sizeof (float));
+	}
+    }
+    _nr = _n;
+
+    float *y1 = _y + TPOVS_PRE * s;
+    float *y2 = y1 + _len;
+    float *y3 = y2 + _len;
+    int j = tpovs_run<TpLane> (_x, _cv, y1, y2, y3, s, n);
+    if (j < n)
+    {
+	tpovs_run<LaneFlt> (_x + j, _c1, y1 + j, y2 + j, y3 + j, s, n - j);
+    }
+
+    for (int row = 0; row < _factor - 4; ++row)
+    {
+	j = tpovs_half<TpLane> (_ha [row], _hb [row], _gv, _hw [row], 0, n);
+	tpovs_half<LaneFlt> (_ha [row], _hb [row], _g1, _hw [row], j, n);
+    }
+}
+
+};
+/* vi:set ts=8 sts=8 sw=4: */
@@ -0,0 +1,114 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __TPOVERSAMPLER_H
+#define	__TPOVERSAMPLER_H
+
+#include "../zita-resampler/resampler-table.h"
+
+#define TPOVS_HL    24              // filter half length, as Resampler::setup (fs, 4 * fs, 1, 24, 1.0)
+#define TPOVS_NT    (2 * TPOVS_HL)  // taps per phase
+#define TPOVS_HB    8               // half length of the 2x halfband stages (8x, 16x)
+#define TPOVS_PRE   8               // frames of history kept before the phase outputs
+#define TPOVS_CHUNK 256             // max samples (frames * channels) per process() call
+
+namespace LV2M {
+
+/* Upsampler for true-peak detection, 4x, 8x or 16x, any number of
+ * channels.
+ *
+ * 4x has the same filter, latency and output as the generic Resampler
+ * set up for 4 * fsamp with hl = 24: the coefficients are taken from
+ * the Resampler_table and re-arranged per tap, one copy per SIMD lane,
+ * once per process for all instances. The history is kept interleaved (frame major), so a tap
+ * is a single load at a stride of nchan floats, and 4 (SSE) or 8 (AVX)
+ * consecutive samples are filtered per instruction for each of the
+ * phases 1..3, whatever the channel count. Phase 0 coincides with
+ * the input samples (sinc zero-crossings) and is not computed.
+ *
+ * 8x and 16x add 2x halfband stages. The 4x signal only occupies a
+ * quarter of its band, so a short filter suffices: the even phases
+ * are those of the previous stage, and each odd phase is a symmetric
+ * 16 tap sum. This costs a fraction of a 48 tap polyphase filter per
+ * additional phase. Every stage delays the output by a few frames.
+ *
+ * The result is phase-planar: out (ph) [i * nchan + c] is phase ph of
+ * frame i, channel c, valid until the next process() call.
+ */
+class Tpoversampler
+{
+public:
+
+    Tpoversampler (void);
+    ~Tpoversampler (void);
+
+    void init (int nchan = 1, int factor = 4); // allocates, not realtime safe
+    void reset (void);
+    void process (const float * const *p, int i, int n) { load (p, i, n); run (); }
+    void process (const float *p, int n) { process (&p, 0, n); }
+
+    /* process() in two steps: load() appends frames i .. i + n - 1 of
+     * p [nchan], n <= chunk (), to the history, run() filters them.
+     * In between, win () can be inspected to skip run (), 4x only:
+     * any output of the chunk is at most gain () times the largest
+     * absolute value of its channel in win ().
+     */
+    void load (const float * const *p, int i, int n);
+    void run (void);
+
+    int nchan (void) const { return _nchan; }
+    int factor (void) const { return _factor; }
+    int chunk (void) const { return _chunk; }
+    float gain (void) const { return _gain; }
+    const float *win (void) const { return _x; } // TPOVS_NT - 1 + n frames, interleaved
+    const float *inp (void) const { return _x + (TPOVS_NT - 1) * _nchan; }
+    const float *out (int ph) const { return _out [ph]; }
+
+private:
+
+    Tpoversampler (const Tpoversampler&);
+    Tpoversampler& operator= (const Tpoversampler&);
+
+    void stage (const float * const *inp, int r, int row, const float **out);
+    static void init_coeff (void);
+
+    int              _nchan;
+    int              _factor;
+    int              _chunk;  // max frames per process() call
+    int              _cap;    // _chunk * _nchan
+    int              _len;    // (TPOVS_PRE + _chunk) * _nchan, size of a phase buffer
+    int              _n;      // frames of the last load()
+    int              _nr;     // frames of the last run()
+    float            _gain;   // bound of the output / input peak ratio, 4x
+    float           *_mem;
+    const float     *_cv;     // [TPOVS_NT][3][SIMD width] phases 1..3, aligned, shared
+    const float     *_c1;     // [TPOVS_NT][3] scalar, for the last (n % SIMD width) samples
+    const float     *_gv;     // [TPOVS_HB][SIMD width] halfband
+    const float     *_g1;     // [TPOVS_HB] scalar
+    float           *_y;      // [_factor - 1][_len] computed phases, TPOVS_PRE frames of history each
+    float           *_x;      // TPOVS_NT - 1 frames of history, followed by the input, interleaved
+
+    // halfband stages, one row per odd output phase: 4 (8x) + 8 (16x)
+    const float     *_ha [12][TPOVS_HB];  // z [t - j] for j < TPOVS_HB
+    const float     *_hb [12][TPOVS_HB];  // z [t + 1 + j]
+    float           *_hw [12];            // output
+    const float     *_out [16];
+};
+
+};
+
+#endif
@@ -16,156 +16,56 @@
  */
 
 
-#include <stdlib.h>
-#include <assert.h>
-#include <math.h>
 #include "truepeakdsp.h"
 
 namespace LV2M {
 
 TruePeakdsp::TruePeakdsp (void)
-	: _m (0)
-	, _p (0)
-	, _res (true)
-	, _buf (NULL)
 {
 }
 
 
 TruePeakdsp::~TruePeakdsp (void)
 {
-	free(_buf);
 }
 
 
 void TruePeakdsp::process (float *data, int n)
 {
-	assert (n > 0);
-	assert (n <= 8192);
-	_src.inp_count = n;
-	_src.inp_data = data;
-	_src.out_count = n * 4;
-	_src.out_data = _buf;
-	_src.process ();
-
-	float v;
-	float m = _res ? 0: _m;
-	float p = _res ? 0: _p;
-	float z1 = _z1 > 20 ? 20 : (_z1 < 0 ? 0 : _z1);
-	float z2 = _z2 > 20 ? 20 : (_z2 < 0 ? 0 : _z2);
-	float *b = _buf;
-
-	while (n--) {
-		z1 *= _w3;
-		z2 *= _w3;
-
-		v = fabsf(*b++);
-		if (v > z1) z1 += _w1 * (v - z1);
-		if (v > z2) z2 += _w2 * (v - z2);
-		if (v > p) p = v;
-
-		v = fabsf(*b++);
-		if (v > z1) z1 += _w1 * (v - z1);
-		if (v > z2) z2 += _w2 * (v - z2);
-		if (v > p) p = v;
-
-		v = fabsf(*b++);
-		if (v > z1) z1 += _w1 * (v - z1);
-		if (v > z2) z2 += _w2 * (v - z2);
-		if (v > p) p = v;
-
-		v = fabsf(*b++);
-		if (v > z1) z1 += _w1 * (v - z1);
-		if (v > z2) z2 += _w2 * (v - z2);
-		if (v > p) p = v;
-
-		v = z1 + z2;
-		if (v > m) m = v;
-	}
-
-	_z1 = z1 + 1e-20f;
-	_z2 = z2 + 1e-20f;
-
-	m *= _g;
-
-	if (_res) {
-		_m = m;
-		_p = p;
-		_res = false;
-	} else {
-		if (m > _m) { _m = m; }
-		if (p > _p) { _p = p; }
-	}
+	_mtr.process (&data, n);
+}
+
+
+void TruePeakdsp::process (float *data, float *q, int n)
+{
+	_mtr.process (&data, &q, n);
 }
 
 void TruePeakdsp::process_max (float *p, int n)
 {
-	assert (n <= 8192);
-	_src.inp_count = n;
-	_src.inp_data = p;
-	_src.out_count = n * 4;
-	_src.out_data = _buf;
-	_src.process ();
-
-	float m = _res ? 0 : _m;
-	float v;
-	float *b = _buf;
-	while (n--) {
-		v = fabsf(*b++);
-		if (v > m) m = v;
-		v = fabsf(*b++);
-		if (v > m) m = v;
-		v = fabsf(*b++);
-		if (v > m) m = v;
-		v = fabsf(*b++);
-		if (v > m) m = v;
-	}
-	_m = m;
+	_mtr.process_max (&p, n);
 }
 
 
 float TruePeakdsp::read (void)
 {
-	_res = true;
-	return _m;
+	return _mtr.read (0);
 }
 
 void TruePeakdsp::read (float &m, float &p)
 {
-	_res = true;
-	m = _m;
-	p = _p;
+	_mtr.read (0, m, p);
 }
 
 void TruePeakdsp::reset ()
 {
-	_res = true;
-	_m = 0;
-	_p = 0;
+	_mtr.reset ();
 }
 
 
-void TruePeakdsp::init (float fsamp)
+void TruePeakdsp::init (float fsamp, int factor)
 {
-	_src.setup(fsamp, fsamp * 4.0, 1, 24, 1.0);
-	_buf = (float*) malloc(32768 * sizeof(float));
-
-	_z1 = _z2 = .0f;
-	_w1 = 4000.0f / fsamp / 4.0;
-	_w2 = 17200.0f / fsamp / 4.0;
-	_w3 = 1.0f - 7.0f / fsamp / 4.0;
-	_g = 0.502f;
-
-	/* q/d initialize */
-	float zero[8192];
-	for (int i = 0; i < 8192; ++i) {
-		zero[i]= 0.0;
-	}
-	_src.inp_count = 8192;
-	_src.inp_data = zero;
-	_src.out_count = 32768;
-	_src.out_data = _buf;
-	_src.process ();
+	_mtr.init (1, fsamp, factor);
 }
 
 };
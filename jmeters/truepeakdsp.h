@@ -21,10 +21,13 @@
 #define	__TRUEPEAKDSP_H
 
 #include "jmeterdsp.h"
-#include "../zita-resampler/resampler.h"
+#include "truepeakmultidsp.h"
 
 namespace LV2M {
 
+/* Single channel true-peak meter, see TruePeakMultidsp.
+ * factor selects 4x (default), 8x or 16x oversampling.
+ */
 class TruePeakdsp : public JmeterDSP
 {
 public:
@@ -33,27 +36,17 @@ public:
     ~TruePeakdsp (void);
 
     void process (float *p, int n);
+    void process (float *p, float *q, int n); // and copy p to q
     void process_max (float *p, int n);
     float read (void);
     void  read (float &m, float &p);
     void  reset (void);
 
-    void init (float fsamp);
+    void init (float fsamp, int factor = 4);
 
 private:
 
-    float      _m;
-    float      _p;
-    float      _z1;
-    float      _z2;
-    bool       _res;
-		float     *_buf;
-		Resampler  _src;
-
-    float   _w1;  // attack filter coefficient
-    float   _w2;  // attack filter coefficient
-    float   _w3;  // release filter coefficient
-    float   _g;   // gain factor
+    TruePeakMultidsp _mtr;
 };
 
 };
@@ -0,0 +1,260 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <math.h>
+#include "truepeakmultidsp.h"
+
+namespace LV2M {
+
+/* Ballistics of channel c over n frames, all F phases in time order */
+template <int F>
+static void tp_ballistics (const Tpoversampler &src, int c, int n,
+		float w1, float w2, float w3, float &z1, float &z2, float &m, float &pk)
+{
+	const int s = src.nchan ();
+	const float *b[F];
+	for (int ph = 0; ph < F; ++ph) {
+		b[ph] = src.out (ph) + c;
+	}
+
+	for (int i = 0; i < n * s; i += s) {
+		z1 *= w3;
+		z2 *= w3;
+
+		for (int ph = 0; ph < F; ++ph) {
+			const float v = fabsf(b[ph][i]);
+			if (v > z1) z1 += w1 * (v - z1);
+			if (v > z2) z2 += w2 * (v - z2);
+			if (v > pk) pk = v;
+		}
+
+		const float v = z1 + z2;
+		if (v > m) m = v;
+	}
+}
+
+/* Max absolute value of channel c over n frames */
+template <int F>
+static float tp_max (const Tpoversampler &src, int c, int n, float m)
+{
+	const int s = src.nchan ();
+	const float *b[F];
+	for (int ph = 0; ph < F; ++ph) {
+		b[ph] = src.out (ph) + c;
+	}
+
+	for (int i = 0; i < n * s; i += s) {
+		for (int ph = 0; ph < F; ++ph) {
+			const float v = fabsf(b[ph][i]);
+			if (v > m) m = v;
+		}
+	}
+	return m;
+}
+
+
+TruePeakMultidsp::TruePeakMultidsp (void)
+	: _nchan (0)
+	, _lazy (false)
+	, _m (0)
+	, _p (0)
+	, _t (0)
+	, _hold (0)
+	, _z1 (0)
+	, _z2 (0)
+	, _res (0)
+{
+}
+
+
+TruePeakMultidsp::~TruePeakMultidsp (void)
+{
+	free (_m);
+	free (_res);
+}
+
+
+void TruePeakMultidsp::process (float * const *p, int n)
+{
+	process (p, 0, n);
+}
+
+
+void TruePeakMultidsp::process (float * const *p, float * const *q, int n)
+{
+	assert (n > 0);
+	const int s = _nchan;
+
+	for (int c = 0; c < s; ++c) {
+		_z1[c] = _z1[c] > 20 ? 20 : (_z1[c] < 0 ? 0 : _z1[c]);
+		_z2[c] = _z2[c] > 20 ? 20 : (_z2[c] < 0 ? 0 : _z2[c]);
+		if (_res[c]) {
+			_m[c] = 0;
+			_p[c] = 0;
+		}
+		_t[c] = 0;
+	}
+
+	for (int off = 0; off < n;) {
+		const int k = n - off < _src.chunk () ? n - off : _src.chunk ();
+		_src.process (p, off, k);
+
+		if (q) {
+			/* all inputs of the chunk are in the oversampler's history by now,
+			 * an output may alias the input of another channel */
+			const float *x = _src.inp ();
+			for (int c = 0; c < s; ++c) {
+				float *qc = q[c] + off;
+				for (int i = 0; i < k; ++i) {
+					qc[i] = x[i * s + c];
+				}
+			}
+		}
+
+		for (int c = 0; c < s; ++c) {
+			switch (_src.factor ()) {
+				case 4:
+					tp_ballistics<4> (_src, c, k, _w1, _w2, _w3, _z1[c], _z2[c], _t[c], _p[c]);
+					break;
+				case 8:
+					tp_ballistics<8> (_src, c, k, _w1, _w2, _w3, _z1[c], _z2[c], _t[c], _p[c]);
+					break;
+				case 16:
+					tp_ballistics<16> (_src, c, k, _w1, _w2, _w3, _z1[c], _z2[c], _t[c], _p[c]);
+					break;
+			}
+		}
+		off += k;
+	}
+
+	for (int c = 0; c < s; ++c) {
+		_z1[c] += 1e-20f;
+		_z2[c] += 1e-20f;
+		const float m = _t[c] * _g;
+		if (m > _m[c]) { _m[c] = m; }
+		_res[c] = false;
+	}
+}
+
+void TruePeakMultidsp::process_max (float * const *p, int n)
+{
+	const int s = _nchan;
+
+	for (int c = 0; c < s; ++c) {
+		if (_res[c]) {
+			_m[c] = 0;
+		}
+	}
+
+	for (int off = 0; off < n;) {
+		const int k = n - off < _src.chunk () ? n - off : _src.chunk ();
+		_src.load (p, off, k);
+		off += k;
+
+		if (_lazy && _src.factor () == 4 && below_max (k)) {
+			continue;
+		}
+		_src.run ();
+
+		for (int c = 0; c < s; ++c) {
+			switch (_src.factor ()) {
+				case 4:  _m[c] = tp_max<4>  (_src, c, k, _m[c]); break;
+				case 8:  _m[c] = tp_max<8>  (_src, c, k, _m[c]); break;
+				case 16: _m[c] = tp_max<16> (_src, c, k, _m[c]); break;
+			}
+		}
+	}
+}
+
+/* true if no output of the loaded chunk of n frames can exceed the current
+ * maximum or a previous reading, for any channel */
+bool TruePeakMultidsp::below_max (int n)
+{
+	const int s = _nchan;
+	const int len = (TPOVS_NT - 1 + n) * s;
+	const float *w = _src.win ();
+
+	for (int c = 0; c < s; ++c) {
+		float pk = 0;
+		for (int i = c; i < len; i += s) {
+			const float v = fabsf(w[i]);
+			if (v > pk) pk = v;
+		}
+		const float gate = _m[c] > _hold[c] ? _m[c] : _hold[c];
+		if (pk * _src.gain () > gate) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+float TruePeakMultidsp::read (int c)
+{
+	_res[c] = true;
+	if (_m[c] > _hold[c]) { _hold[c] = _m[c]; }
+	return _m[c];
+}
+
+void TruePeakMultidsp::read (int c, float &m, float &p)
+{
+	_res[c] = true;
+	if (_m[c] > _hold[c]) { _hold[c] = _m[c]; }
+	m = _m[c];
+	p = _p[c];
+}
+
+void TruePeakMultidsp::reset ()
+{
+	for (int c = 0; c < _nchan; ++c) {
+		_res[c] = true;
+		_m[c] = 0;
+		_p[c] = 0;
+		_hold[c] = 0;
+	}
+}
+
+
+void TruePeakMultidsp::init (int nchan, float fsamp, int factor)
+{
+	assert (nchan > 0);
+	_nchan = nchan;
+
+	free (_m);
+	free (_res);
+	_m    = (float*) calloc (6 * nchan, sizeof (float));
+	_p    = _m + nchan;
+	_t    = _p + nchan;
+	_hold = _t + nchan;
+	_z1   = _hold + nchan;
+	_z2   = _z1 + nchan;
+	_res  = (bool*) calloc (nchan, sizeof (bool));
+
+	_src.init (nchan, factor);
+
+	/* attack per oversampled value, release per frame */
+	_w1 = 4000.0f / fsamp / factor;
+	_w2 = 17200.0f / fsamp / factor;
+	_w3 = 1.0f - 7.0f / fsamp / 4.0;
+	_g = 0.502f;
+
+	reset ();
+}
+
+};
@@ -0,0 +1,92 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __TRUEPEAKMULTIDSP_H
+#define	__TRUEPEAKMULTIDSP_H
+
+#include "tpoversampler.h"
+
+namespace LV2M {
+
+/* True-peak meter for all channels of a stream.
+ *
+ * Same ballistics and readings as one single channel meter per
+ * channel, but the channels share a single interleaved oversampler:
+ * one filter walk per period, whose SIMD lanes span channels and frames.
+ * Reading a channel resets that channel only.
+ *
+ * factor selects 4x, 8x or 16x oversampling. 4x may under-read
+ * inter-sample peaks close to fsamp / 2 by a few tenths of a dB,
+ * notably at 44.1 kHz, 8x and 16x are for precise measurements.
+ *
+ * In lazy mode (4x only), process_max() oversamples only chunks whose sample
+ * peak (times the filter's worst case gain) could exceed both the
+ * current maximum and every value read() so far. read() may then
+ * return less than the period's maximum, but only if the latter does
+ * not exceed an earlier reading, so a running maximum kept by the
+ * caller is unchanged. reset() restarts the comparison.
+ * The halfband stages of 8x and 16x filter the previous chunk's 4x
+ * output, no chunk can be skipped there and lazy mode has no effect.
+ */
+class TruePeakMultidsp
+{
+public:
+
+    TruePeakMultidsp (void);
+    ~TruePeakMultidsp (void);
+
+    void init (int nchan, float fsamp, int factor = 4); // allocates, not realtime safe
+    void process (float * const *p, int n);
+    void process (float * const *p, float * const *q, int n); // and copy p to q
+    void process_max (float * const *p, int n);
+    void lazy (bool on) { _lazy = on; }
+    float read (int c);
+    void  read (int c, float &m, float &p);
+    void  reset (void);
+
+    int nchan (void) const { return _nchan; }
+
+private:
+
+    TruePeakMultidsp (const TruePeakMultidsp&);
+    TruePeakMultidsp& operator= (const TruePeakMultidsp&);
+
+    bool below_max (int n);
+
+    int            _nchan;
+    bool           _lazy;
+
+    // per channel state [_nchan]
+    float         *_m;
+    float         *_p;
+    float         *_t;           // max of the current period, before gain
+    float         *_hold;        // max of all read() values since reset(), lazy mode
+    float         *_z1;
+    float         *_z2;
+    bool          *_res;
+
+    Tpoversampler  _src;
+
+    float   _w1;  // attack filter coefficient
+    float   _w2;  // attack filter coefficient
+    float   _w3;  // release filter coefficient
+    float   _g;   // gain factor
+};
+
+};
+
+#endif
@@ -20,52 +20,50 @@
 
 
 #include <math.h>
+#include "jmeterkernel.h"
 #include "vumeterdsp.h"
 
 namespace LV2M {
 
-float  Vumeterdsp::_w = 0;
-float  Vumeterdsp::_g = 0; 
-
-
 Vumeterdsp::Vumeterdsp (void) :
     _z1 (0),
     _z2 (0),
     _m (0),
-    _res (true)
+    _res (true),
+    _ph (0),
+    _coef (0)
 {
 }
 
 
 Vumeterdsp::~Vumeterdsp (void)
 {
+    Jmetercoeff::destroy (_coef);
 }
 
 
 void Vumeterdsp::process (float *p, int n)
 {
-    float z1, z2, m, t1, t2;
+    process (p, 0, n);
+}
+
+
+void Vumeterdsp::process (float *p, float *q, int n)
+{
+    float z1, z2, m;
+    const float w = _coef->_w1;
 
     z1 = _z1 > 20 ? 20 : (_z1 < -20 ? -20 : _z1);
     z2 = _z2 > 20 ? 20 : (_z2 < -20 ? -20 : _z2);
     m = _res ? 0: _m;
     _res = false;
 
-    n /= 4;
-    while (n--)
-    {
-	t2 = z2 / 2;
-	t1 = fabsf (*p++) - t2;
-	z1 += _w * (t1 - z1);
-	t1 = fabsf (*p++) - t2;
-	z1 += _w * (t1 - z1);
-	t1 = fabsf (*p++) - t2;
-	z1 += _w * (t1 - z1);
-	t1 = fabsf (*p++) - t2;
-	z1 += _w * (t1 - z1);
-	z2 += 4 * _w * (z1 - z2);
-	if (z2 > m) m = z2;
-    }
+    VumeterKernel<LaneFlt> k (w, z1, z2, m);
+    if (q) _ph = jmeter_run<8> (k, SrcMonoCopy (p, q, n), n, _ph);
+    else   _ph = jmeter_run<8> (k, SrcMono (p), n, _ph);
+    z1 = k._z1;
+    z2 = k._z2;
+    m = k._m;
 
     if (!isfinite(z1)) {_z1 = 0; m = INFINITY;} else _z1 = z1;
     if (!isfinite(z2)) {_z2 = 0; m = INFINITY;} else _z2 = z2 + 1e-10f;
@@ -76,14 +74,14 @@ void Vumeterdsp::process (float *p, int n)
 float Vumeterdsp::read (void)
 {
     _res = true;
-    return _g * _m;
+    return _coef->_g * _m;
 }
 
 
 void Vumeterdsp::init (float fsamp)
 {
-    _w = 11.1f / fsamp; 
-    _g = 1.5f * 1.571f;
+    Jmetercoeff::destroy (_coef);
+    _coef = Jmetercoeff::create (Jmetercoeff::VUMETER, fsamp);
 }
 
 };
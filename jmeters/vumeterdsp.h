@@ -23,6 +23,7 @@
 #define	__VUMETERDSP_H
 
 #include "jmeterdsp.h"
+#include "jmetercoeff.h"
 
 namespace LV2M {
 
@@ -33,10 +34,11 @@ public:
     Vumeterdsp (void);
     ~Vumeterdsp (void);
 
-    void process (float *p, int n);  
+    void process (float *p, int n);
+    void process (float *p, float *q, int n); // and copy p to q
     float read (void);
 
-    static void init (float fsamp); 
+    void init (float fsamp);
 
 private:
 
@@ -44,9 +46,9 @@ private:
     float          _z2;          // filter state
     float          _m;           // max value since last read()
     bool           _res;         // flag to reset m
+    int            _ph;          // position in the current 4 sample sub-block
 
-    static float   _w;           // lowpass filter coefficient
-    static float   _g;           // gain factor
+    const Jmetercoeff *_coef;    // lowpass filter coefficient, gain factor
 };
 
 };
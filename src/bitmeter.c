@@ -181,6 +181,7 @@ bim_connect_port (LV2_Handle instance, uint32_t port, void* data)
 static void
 bim_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 
 	const uint32_t capacity = self->notify->atom.size;
@@ -0,0 +1,157 @@
+/* meter.lv2 -- all level standards of a stereo bus in one pass
+ *
+ * Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+typedef enum {
+	BUS_REFLEVEL = 0,
+	BUS_INPUT0,
+	BUS_OUTPUT0,
+	BUS_INPUT1,
+	BUS_OUTPUT1,
+	BUS_VU0, BUS_VU1,
+	BUS_IEC1_0, BUS_IEC1_1,
+	BUS_IEC2_0, BUS_IEC2_1,
+	BUS_K20_RMS0, BUS_K20_RMS1,
+	BUS_K20_PEAK0, BUS_K20_PEAK1,
+	BUS_TP_LVL0, BUS_TP_LVL1,
+	BUS_TP_PEAK0, BUS_TP_PEAK1,
+	BUS_COR,
+	BUS_LAST
+} BusPortIndex;
+
+typedef struct {
+	float* reflvl;
+	float* input[2];
+	float* output[2];
+	float* p_out[BUS_LAST]; // meter readings, BUS_VU0 ..
+
+	float rlgain;
+	float p_refl;
+
+	Busmeterdsp* bus;
+} LV2busmeter;
+
+/******************************************************************************
+ * LV2
+ */
+
+static LV2_Handle
+bus_instantiate(
+		const LV2_Descriptor*     descriptor,
+		double                    rate,
+		const char*               bundle_path,
+		const LV2_Feature* const* features)
+{
+	if (strcmp(descriptor->URI, MTR_URI "BUSstereo")) {
+		return NULL;
+	}
+
+	LV2busmeter* self = (LV2busmeter*)calloc(1, sizeof(LV2busmeter));
+	if (!self) return NULL;
+
+	self->bus = new Busmeterdsp();
+	self->bus->init(rate);
+
+	self->rlgain = 1.0;
+	self->p_refl = -9999;
+
+	return (LV2_Handle)self;
+}
+
+static void
+bus_connect_port(LV2_Handle instance, uint32_t port, void* data)
+{
+	LV2busmeter* self = (LV2busmeter*)instance;
+	switch (port) {
+	case BUS_REFLEVEL:
+		self->reflvl = (float*) data;
+		break;
+	case BUS_INPUT0:
+		self->input[0] = (float*) data;
+		break;
+	case BUS_OUTPUT0:
+		self->output[0] = (float*) data;
+		break;
+	case BUS_INPUT1:
+		self->input[1] = (float*) data;
+		break;
+	case BUS_OUTPUT1:
+		self->output[1] = (float*) data;
+		break;
+	default:
+		if (port < BUS_LAST) {
+			self->p_out[port] = (float*) data;
+		}
+		break;
+	}
+}
+
+static void
+bus_run(LV2_Handle instance, uint32_t n_samples)
+{
+	DenormalGuard dg;
+	LV2busmeter* self = (LV2busmeter*)instance;
+	Busmeterdsp* const bus = self->bus;
+
+	/* reference level of the needle meters, same as run() */
+	if (self->p_refl != *self->reflvl) {
+		self->p_refl = *self->reflvl;
+		self->rlgain = powf (10.0f, 0.05f * (self->p_refl + 18.0));
+	}
+
+	if (self->input[0] != self->output[0] || self->input[1] != self->output[1]) {
+		bus->process(self->input[0], self->input[1], n_samples, self->output[0], self->output[1]);
+	} else {
+		bus->process(self->input[0], self->input[1], n_samples);
+	}
+
+	for (uint32_t c = 0; c < 2; ++c) {
+		float m, p;
+		*self->p_out[BUS_VU0 + c]    = self->rlgain * bus->read_vu(c);
+		*self->p_out[BUS_IEC1_0 + c] = self->rlgain * bus->read_iec1(c);
+		*self->p_out[BUS_IEC2_0 + c] = self->rlgain * bus->read_iec2(c);
+
+		bus->read_kmeter(c, m, p);
+		*self->p_out[BUS_K20_RMS0 + c]  = m;
+		*self->p_out[BUS_K20_PEAK0 + c] = p;
+
+		bus->read_truepeak(c, m, p);
+		*self->p_out[BUS_TP_LVL0 + c]  = m;
+		*self->p_out[BUS_TP_PEAK0 + c] = p;
+	}
+	*self->p_out[BUS_COR] = bus->read_cor();
+}
+
+static void
+bus_cleanup(LV2_Handle instance)
+{
+	LV2busmeter* self = (LV2busmeter*)instance;
+	delete self->bus;
+	free(instance);
+}
+
+static const LV2_Descriptor descriptorBUS = {
+	MTR_URI "BUSstereo",
+	bus_instantiate,
+	bus_connect_port,
+	NULL,
+	bus_run,
+	NULL,
+	bus_cleanup,
+	extension_data
+};
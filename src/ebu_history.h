@@ -0,0 +1,349 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* EBU R128 loudness history, shared by the plugin, its UI and x42-r128log
+ *
+ * If enabled, the plugin appends one point per 100ms (max. momentary and
+ * short-term loudness, true-peak) to a memory-mapped file. At 6 bytes per
+ * point 24 hours take 5MB, after that the oldest points are overwritten.
+ *
+ * There is a single writer. `n_points` counts all points ever written
+ * and is stored after the point itself, readers load it first and
+ * can use the last min (n_points - reset, size) points.
+ *
+ * Writing to a file mapping can fault and block in the filesystem, so
+ * the realtime thread does not: EbuHistoryLog passes its points through
+ * a lock-free FIFO to a thread that appends them to the file.
+ */
+
+#ifndef EBU_HISTORY_H
+#define EBU_HISTORY_H
+
+#ifndef _WIN32 // no mmap
+#define EBU_HISTORY
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#define EBU_HISTORY_MAGIC   "x42R128H"
+#define EBU_HISTORY_VERSION 1
+#define EBU_HISTORY_RATE    10                            // points per second
+#define EBU_HISTORY_LEN     (24 * 3600 * EBU_HISTORY_RATE) // 24h
+#define EBU_HISTORY_NONE    INT16_MIN                     // no value
+#define EBU_HISTORY_FIFO    128                           // points, power of two
+
+typedef struct {
+	int16_t m;  // momentary loudness [1/100 LUFS]
+	int16_t s;  // short-term loudness [1/100 LUFS]
+	int16_t tp; // true-peak [1/100 dBTP]
+} EbuHistoryPoint;
+
+typedef struct {
+	char     magic[8];
+	uint32_t version;
+	uint32_t rate;     // points per second
+	uint32_t size;     // number of points, ring-buffer
+	uint32_t reserved;
+	int64_t  created;  // time(), when the log was created
+	uint64_t n_points; // points written, incl. overwritten ones
+	uint64_t reset;    // value of n_points at the last meter reset
+	/* followed by EbuHistoryPoint[size] */
+} EbuHistory;
+
+static inline size_t
+ebu_history_bytes (uint32_t size)
+{
+	return sizeof (EbuHistory) + size * sizeof (EbuHistoryPoint);
+}
+
+static inline EbuHistoryPoint*
+ebu_history_point (const EbuHistory* h, uint64_t n)
+{
+	return (EbuHistoryPoint*)(h + 1) + (n % h->size);
+}
+
+static inline int16_t
+ebu_history_enc (float v)
+{
+	if (!isfinite (v) || v <= -200.f) return EBU_HISTORY_NONE;
+	if (v > 327.f) return INT16_MAX;
+	return (int16_t) lrintf (v * 100.f);
+}
+
+static inline float
+ebu_history_dec (int16_t v)
+{
+	if (v == EBU_HISTORY_NONE) return -INFINITY;
+	return v * .01f;
+}
+
+/* creates a new file, returns NULL on error.
+ * Only the header is written. The space is reserved, so that
+ * appending to the log cannot fault on a full disk. */
+static inline EbuHistory*
+ebu_history_create (const char* path, int64_t created)
+{
+	const size_t len = ebu_history_bytes (EBU_HISTORY_LEN);
+	int fd = open (path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return NULL;
+	}
+#ifdef __APPLE__
+	const int err = ftruncate (fd, len);
+#else
+	const int err = posix_fallocate (fd, 0, len);
+#endif
+	if (err) {
+		close (fd);
+		unlink (path);
+		return NULL;
+	}
+	void* p = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (p == MAP_FAILED) {
+		unlink (path);
+		return NULL;
+	}
+	memset (p, 0, sizeof (EbuHistory));
+
+	EbuHistory* h = (EbuHistory*)p;
+	h->version = EBU_HISTORY_VERSION;
+	h->rate    = EBU_HISTORY_RATE;
+	h->size    = EBU_HISTORY_LEN;
+	h->created = created;
+	memcpy (h->magic, EBU_HISTORY_MAGIC, 8);
+	return h;
+}
+
+/* maps an existing file read-only, returns NULL on error */
+static inline EbuHistory*
+ebu_history_open (const char* path)
+{
+	struct stat st;
+	int fd = open (path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+	if (fstat (fd, &st) || (size_t)st.st_size < sizeof (EbuHistory)) {
+		close (fd);
+		return NULL;
+	}
+	void* p = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	EbuHistory* h = (EbuHistory*)p;
+	if (memcmp (h->magic, EBU_HISTORY_MAGIC, 8)
+			|| h->version != EBU_HISTORY_VERSION
+			|| h->rate == 0 || h->size == 0
+			|| ebu_history_bytes (h->size) != (size_t)st.st_size) {
+		munmap (p, st.st_size);
+		return NULL;
+	}
+	return h;
+}
+
+static inline void
+ebu_history_close (EbuHistory* h)
+{
+	if (h) munmap ((void*)h, ebu_history_bytes (h->size));
+}
+
+/* writer only, not realtime safe */
+static inline void
+ebu_history_append (EbuHistory* h, const EbuHistoryPoint* p)
+{
+	const uint64_t n = h->n_points;
+	*ebu_history_point (h, n) = *p;
+	__atomic_store_n (&h->n_points, n + 1, __ATOMIC_RELEASE);
+}
+
+/* writer only, not realtime safe */
+static inline void
+ebu_history_reset (EbuHistory* h, uint64_t n)
+{
+	__atomic_store_n (&h->reset, n, __ATOMIC_RELEASE);
+}
+
+/* the range of valid points [*first, return-value) */
+static inline uint64_t
+ebu_history_range (const EbuHistory* h, uint64_t* first)
+{
+	const uint64_t n = __atomic_load_n (&h->n_points, __ATOMIC_ACQUIRE);
+	uint64_t f = __atomic_load_n (&h->reset, __ATOMIC_ACQUIRE);
+	if (n > h->size && f < n - h->size) {
+		f = n - h->size;
+	}
+	*first = f > n ? n : f;
+	return n;
+}
+
+/* the realtime side of a log, see ebu_history_log_start () */
+
+typedef struct {
+	uint64_t        n;     // point index, or the n_points of a reset
+	EbuHistoryPoint p;
+	bool            reset;
+} EbuHistoryEntry;
+
+typedef struct {
+	EbuHistory*     h;
+	uint64_t        n;     // points sent, realtime thread only
+	EbuHistoryEntry fifo[EBU_HISTORY_FIFO];
+	uint32_t        wp;
+	uint32_t        rp;
+	bool            run;
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  ready;
+} EbuHistoryLog;
+
+/* write thread: points lost to a full FIFO are logged as "no value" */
+static inline void
+ebu_history_log_fill (EbuHistory* h, uint64_t n)
+{
+	const EbuHistoryPoint none = { EBU_HISTORY_NONE, EBU_HISTORY_NONE, EBU_HISTORY_NONE };
+	while (h->n_points < n) {
+		ebu_history_append (h, &none);
+	}
+}
+
+/* write thread: append all points in the FIFO */
+static inline void
+ebu_history_log_drain (EbuHistoryLog* l)
+{
+	const uint32_t wp = __atomic_load_n (&l->wp, __ATOMIC_ACQUIRE);
+	uint32_t       rp = l->rp;
+	for (; rp != wp; rp = (rp + 1) & (EBU_HISTORY_FIFO - 1)) {
+		const EbuHistoryEntry* e = &l->fifo[rp];
+		if (e->reset) {
+			ebu_history_reset (l->h, e->n);
+			continue;
+		}
+		ebu_history_log_fill (l->h, e->n);
+		ebu_history_append (l->h, &e->p);
+	}
+	__atomic_store_n (&l->rp, rp, __ATOMIC_RELEASE);
+}
+
+static void*
+ebu_history_log_main (void* arg)
+{
+	EbuHistoryLog* l = (EbuHistoryLog*)arg;
+	pthread_mutex_lock (&l->lock);
+	while (l->run) {
+		pthread_cond_wait (&l->ready, &l->lock);
+		ebu_history_log_drain (l);
+	}
+	pthread_mutex_unlock (&l->lock);
+	ebu_history_log_drain (l);
+	return NULL;
+}
+
+/* takes ownership of h and starts the write thread, returns NULL on error */
+static inline EbuHistoryLog*
+ebu_history_log_start (EbuHistory* h)
+{
+	EbuHistoryLog* l = (EbuHistoryLog*) calloc (1, sizeof (EbuHistoryLog));
+	if (!l) {
+		ebu_history_close (h);
+		return NULL;
+	}
+	l->h   = h;
+	l->n   = h->n_points;
+	l->run = true;
+	pthread_mutex_init (&l->lock, NULL);
+	pthread_cond_init (&l->ready, NULL);
+	if (pthread_create (&l->thread, NULL, ebu_history_log_main, l)) {
+		pthread_mutex_destroy (&l->lock);
+		pthread_cond_destroy (&l->ready);
+		ebu_history_close (h);
+		free (l);
+		return NULL;
+	}
+	return l;
+}
+
+/* writes the remaining points, closes the log and frees l */
+static inline void
+ebu_history_log_stop (EbuHistoryLog* l)
+{
+	pthread_mutex_lock (&l->lock);
+	l->run = false;
+	pthread_cond_signal (&l->ready);
+	pthread_mutex_unlock (&l->lock);
+	pthread_join (l->thread, NULL);
+	ebu_history_log_fill (l->h, l->n);
+	pthread_mutex_destroy (&l->lock);
+	pthread_cond_destroy (&l->ready);
+	ebu_history_close (l->h);
+	free (l);
+}
+
+/* realtime safe, the entry is dropped if the FIFO is full */
+static inline void
+ebu_history_log_push (EbuHistoryLog* l, const EbuHistoryEntry* e)
+{
+	const uint32_t wp = l->wp;
+	const uint32_t nx = (wp + 1) & (EBU_HISTORY_FIFO - 1);
+	if (nx == __atomic_load_n (&l->rp, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	l->fifo[wp] = *e;
+	__atomic_store_n (&l->wp, nx, __ATOMIC_RELEASE);
+	/* a missed wake-up is made up for by the next point */
+	if (pthread_mutex_trylock (&l->lock) == 0) {
+		pthread_cond_signal (&l->ready);
+		pthread_mutex_unlock (&l->lock);
+	}
+}
+
+/* realtime safe */
+static inline void
+ebu_history_log_append (EbuHistoryLog* l, float m, float s, float tp)
+{
+	EbuHistoryEntry e;
+	e.n     = l->n++;
+	e.p.m   = ebu_history_enc (m);
+	e.p.s   = ebu_history_enc (s);
+	e.p.tp  = ebu_history_enc (tp);
+	e.reset = false;
+	ebu_history_log_push (l, &e);
+}
+
+/* realtime safe */
+static inline void
+ebu_history_log_reset (EbuHistoryLog* l)
+{
+	EbuHistoryEntry e;
+	memset (&e, 0, sizeof (e));
+	e.n     = l->n;
+	e.reset = true;
+	ebu_history_log_push (l, &e);
+}
+
+#endif // _WIN32
+#endif // EBU_HISTORY_H
@@ -23,6 +23,8 @@
 #include <lv2/lv2plug.in/ns/ext/state/state.h>
 #endif
 
+#include <time.h>
+
 /* static functions to be included in meters.cc
  *
  * broken out ebu-r128 related LV2 functions
@@ -35,6 +37,7 @@ typedef enum {
 	EBU_OUTPUT0  = 3,
 	EBU_INPUT1   = 4,
 	EBU_OUTPUT1  = 5,
+	/* surround variants continue with input/output pairs */
 } EBUPortIndex;
 
 
@@ -58,6 +61,12 @@ static void ebu_reset(LV2meter* self) {
 	self->hist_maxM = 0;
 	self->hist_maxS = 0;
 	self->tp_max = -INFINITY;
+	self->tp->reset();
+#ifdef EBU_HISTORY
+	if (self->history) {
+		ebu_history_log_reset(self->history);
+	}
+#endif
 }
 
 static void ebu_integrate(LV2meter* self, bool on) {
@@ -72,6 +81,50 @@ static void ebu_integrate(LV2meter* self, bool on) {
 	}
 }
 
+#ifdef EBU_HISTORY
+/* The loudness log is only written if $X42_EBUR128_HISTORY
+ * names a directory, one file per instance, that is kept. */
+static void ebu_history_init(LV2meter* self) {
+	static int instance_cnt = 0;
+	const char* dir = getenv("X42_EBUR128_HISTORY");
+	if (!dir || !*dir) return;
+	if (strlen(dir) > 192) return; // keep the notification small
+
+	const time_t now = time(NULL);
+	struct tm lt;
+	char date[32];
+	localtime_r(&now, &lt);
+	strftime(date, sizeof(date), "%Y%m%d-%H%M%S", &lt);
+
+	const size_t len = strlen(dir) + 64;
+	self->history_path = (char*) malloc(len);
+	snprintf(self->history_path, len, "%s/x42-ebur128-%s-%d-%d.r128h",
+			dir, date, (int)getpid(), __sync_fetch_and_add(&instance_cnt, 1));
+
+	EbuHistory* h = ebu_history_create(self->history_path, now);
+	self->history = h ? ebu_history_log_start(h) : NULL;
+	if (!self->history) {
+		fprintf(stderr, "EBUrLV2: cannot create loudness log '%s'\n", self->history_path);
+		free(self->history_path);
+		self->history_path = NULL;
+	}
+	self->historyMC = self->historySC = self->historyTPC = -INFINITY;
+}
+
+/* tell the UI to read the radar history from the log */
+static void ebu_history_announce(LV2meter* self) {
+	LV2_Atom_Forge_Frame frame; // max 400 bytes
+	lv2_atom_forge_frame_time(&self->forge, 0);
+	x_forge_object(&self->forge, &frame, 1, self->uris.rdr_history);
+	lv2_atom_forge_property_head(&self->forge, self->uris.rdr_histfile, 0); lv2_atom_forge_path(&self->forge, self->history_path, strlen(self->history_path));
+	lv2_atom_forge_property_head(&self->forge, self->uris.rdr_pointpos, 0); lv2_atom_forge_long(&self->forge, self->history_rdr);
+	lv2_atom_forge_property_head(&self->forge, self->uris.rdr_pos_cur, 0); lv2_atom_forge_int(&self->forge, self->radar_pos_cur);
+	lv2_atom_forge_property_head(&self->forge, self->uris.rdr_pos_max, 0); lv2_atom_forge_int(&self->forge, self->radar_pos_max);
+	lv2_atom_forge_property_head(&self->forge, self->uris.rdr_binlen, 0);  lv2_atom_forge_float(&self->forge, self->radar_spd_max * (float)EBU_HISTORY_RATE / self->rate);
+	lv2_atom_forge_pop(&self->forge, &frame);
+}
+#endif
+
 static void ebu_set_radarspeed(LV2meter* self, float seconds) {
 	self->radar_spd_max = rint(seconds * self->rate / self->radar_pos_max);
 	if (self->radar_spd_max < 4096) self->radar_spd_max = 4096;
@@ -126,7 +179,16 @@ ebur128_instantiate(
 	LV2meter* self = (LV2meter*)calloc(1, sizeof(LV2meter));
 	if (!self) return NULL;
 
-	if (strcmp(descriptor->URI, MTR_URI "EBUr128")) {
+	Ebu_r128_proc::Layout layout;
+	if (!strcmp(descriptor->URI, MTR_URI "EBUr128")) {
+		layout = Ebu_r128_proc::STEREO;
+	} else if (!strcmp(descriptor->URI, MTR_URI "EBUr128_5_1")) {
+		layout = Ebu_r128_proc::SURR_5_1;
+	} else if (!strcmp(descriptor->URI, MTR_URI "EBUr128_7_1")) {
+		layout = Ebu_r128_proc::SURR_7_1;
+	} else if (!strcmp(descriptor->URI, MTR_URI "EBUr128_7_1_4")) {
+		layout = Ebu_r128_proc::SURR_7_1_4;
+	} else {
 		free(self);
 		return NULL;
 	}
@@ -146,7 +208,7 @@ ebur128_instantiate(
 	map_eburlv2_uris(self->map, &self->uris);
 	lv2_atom_forge_init(&self->forge, self->map);
 
-	self->chn = 2;
+	self->chn = Ebu_r128_proc::layout_nchan(layout);
 	self->input  = (float**) calloc (self->chn, sizeof (float*));
 	self->output = (float**) calloc (self->chn, sizeof (float*));
 
@@ -187,13 +249,21 @@ ebur128_instantiate(
 	self->tp_max = -INFINITY;
 
 	self->ebu = new Ebu_r128_proc();
-	self->ebu->init (2, rate);
-
-	self->mtr = (JmeterDSP **)malloc (2 * sizeof (JmeterDSP *));
-	self->mtr[0] = new TruePeakdsp();
-	self->mtr[1] = new TruePeakdsp();
-	static_cast<TruePeakdsp *>(self->mtr[0])->init(rate);
-	static_cast<TruePeakdsp *>(self->mtr[1])->init(rate);
+	self->ebu->init (layout, rate);
+
+	self->tp = new TruePeakMultidsp();
+	self->tp->init(self->chn, rate, TP_FACTOR);
+
+	/* if only the running maximum tp_max is used, the meter
+	 * can skip blocks that cannot exceed it (4x only) */
+	bool tp_lazy = TP_FACTOR == 4;
+#ifdef EBU_HISTORY
+	ebu_history_init(self);
+	if (self->history) {
+		tp_lazy = false; // the log needs the max. of every 100ms
+	}
+#endif
+	self->tp->lazy(tp_lazy);
 
 	return (LV2_Handle)self;
 }
@@ -202,25 +272,25 @@ static void
 ebur128_connect_port(LV2_Handle instance, uint32_t port, void* data)
 {
 	LV2meter* self = (LV2meter*)instance;
+	if (port >= EBU_INPUT0) {
+		const uint32_t c = (port - EBU_INPUT0) / 2;
+		if (c >= self->chn) return;
+		if ((port - EBU_INPUT0) & 1) {
+			self->output[c] = (float*) data;
+		} else {
+			self->input[c] = (float*) data;
+		}
+		return;
+	}
 	switch ((EBUPortIndex)port) {
-	case EBU_INPUT0:
-		self->input[0] = (float*) data;
-		break;
-	case EBU_OUTPUT0:
-		self->output[0] = (float*) data;
-		break;
-	case EBU_INPUT1:
-		self->input[1] = (float*) data;
-		break;
-	case EBU_OUTPUT1:
-		self->output[1] = (float*) data;
-		break;
 	case EBU_NOTIFY:
 		self->notify = (LV2_Atom_Sequence*)data;
 		break;
 	case EBU_CONTROL:
 		self->control = (const LV2_Atom_Sequence*)data;
 		break;
+	default:
+		break;
 	}
 }
 
@@ -239,6 +309,7 @@ static inline float coef_to_db (const float val) {
 static void
 ebur128_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 
 	const uint32_t capacity = self->notify->atom.size;
@@ -267,6 +338,9 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 					self->ui_active = true;
 					self->send_state_to_ui = true;
 					self->radar_resync = 0;
+#ifdef EBU_HISTORY
+					self->history_ui = true;
+#endif
 					/* resync histogram */
 					for (int i=0; i < HIST_LEN; ++i) {
 						self->histM[i] = 0;
@@ -321,6 +395,13 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 							self->ui_settings = (uint32_t) v;
 							self->dbtp_enable = (self->ui_settings & 64) ? true : false;
 							break;
+						case CTL_RADARRESYNC:
+							/* the UI cannot read the loudness log */
+#ifdef EBU_HISTORY
+							self->history_ui = false;
+#endif
+							self->radar_resync = 0;
+							break;
 						default:
 							break;
 					}
@@ -337,15 +418,14 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 	}
 #endif
 
-	/* process audio -- delayline + balance & gain */
-	float *input [] = {self->input[0], self->input[1]};
-	self->ebu->process(n_samples, input);
-
+	/* true-peak first: an output may alias another channel's input */
 	if (self->dbtp_enable) {
-		static_cast<TruePeakdsp*>(self->mtr[0])->process_max(self->input[0], n_samples);
-		static_cast<TruePeakdsp*>(self->mtr[1])->process_max(self->input[1], n_samples);
+		self->tp->process_max(self->input, n_samples);
 	}
 
+	/* process audio, and unless in-place copy input to output */
+	self->ebu->process(n_samples, self->input, self->output);
+
 	/* get processed data */
 	const float lm = self->ebu->loudness_M();
 	const float mm = self->ebu->maxloudn_M();
@@ -357,15 +437,27 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 	const float rn = self->ebu->range_min();
 	const float rx = self->ebu->range_max();
 
+	float tp_cur = -INFINITY;
 	if (self->dbtp_enable) {
-		const float tp0 = self->mtr[0]->read();
-		const float tp1 = self->mtr[1]->read();
-		const float tp = coef_to_db(tp0 > tp1 ? tp0 : tp1);
-		if (tp > self->tp_max) self->tp_max = tp;
-	} else {
+		float tpc = 0;
+		for (uint32_t c = 0; c < self->chn; ++c) {
+			const float tpn = self->tp->read(c);
+			if (tpn > tpc) tpc = tpn;
+		}
+		tp_cur = coef_to_db(tpc);
+		if (tp_cur > self->tp_max) self->tp_max = tp_cur;
+	} else if (self->tp_max != -INFINITY) {
 		self->tp_max = -INFINITY;
+		self->tp->reset();
 	}
 	
+#ifdef EBU_HISTORY
+	if (self->radar_resync == 0 && self->history && self->history_ui) {
+		ebu_history_announce(self);
+		self->radar_resync = -1;
+	}
+#endif
+
 	if (self->radar_resync >= 0) {
 		int batch = (capacity - 512) / 192;
 		if (batch > 16) batch = 16; // limit max data transfer per cycle
@@ -418,8 +510,32 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 		self->radar_spd_cur = self->radar_spd_cur % self->radar_spd_max;
 		self->radar_pos_cur = (self->radar_pos_cur + 1) % self->radar_pos_max;
 		self->radarSC = self->radarMC = -INFINITY;
+#ifdef EBU_HISTORY
+		if (self->history) {
+			self->history_rdr = self->history->n;
+		}
+#endif
 	}
 
+#ifdef EBU_HISTORY
+	/* loudness log, max. of each 100ms */
+	if (self->history) {
+		if (lm > self->historyMC) self->historyMC = lm;
+		if (ls > self->historySC) self->historySC = ls;
+		if (tp_cur > self->historyTPC) self->historyTPC = tp_cur;
+
+		const uint32_t srate = self->rate;
+		self->history_spd += (uint64_t)n_samples * EBU_HISTORY_RATE;
+		if (self->history_spd >= srate) {
+			while (self->history_spd >= srate) {
+				self->history_spd -= srate;
+				ebu_history_log_append(self->history, self->historyMC, self->historySC, self->historyTPC);
+			}
+			self->historyMC = self->historySC = self->historyTPC = -INFINITY;
+		}
+	}
+#endif
+
 	if (self->ui_active) {
 		int msgtx = 0;
 		int countM = self->ebu->hist_M_count();
@@ -480,13 +596,6 @@ ebur128_run(LV2_Handle instance, uint32_t n_samples)
 
 		lv2_atom_forge_pop(&self->forge, &frame);
 	}
-
-	if (self->input[0] != self->output[0]) {
-		memcpy(self->output[0], self->input[0], sizeof(float) * n_samples);
-	}
-	if (self->input[1] != self->output[1]) {
-		memcpy(self->output[1], self->input[1], sizeof(float) * n_samples);
-	}
 #if 0
 	//printf("forged %d bytes\n", self->notify->atom.size);
 	static uint32_t max_cap = 0;
@@ -503,10 +612,14 @@ ebur128_cleanup(LV2_Handle instance)
 	LV2meter* self = (LV2meter*)instance;
 	free(self->radarS);
 	free(self->radarM);
+#ifdef EBU_HISTORY
+	if (self->history) {
+		ebu_history_log_stop(self->history);
+	}
+	free(self->history_path);
+#endif
 	delete self->ebu;
-	delete self->mtr[0];
-	delete self->mtr[1];
-	free (self->mtr);
+	delete self->tp;
 	FREE_VARPORTS;
 	free(instance);
 }
@@ -565,13 +678,19 @@ extension_data_ebur(const char* uri)
   return NULL;
 }
 
-static const LV2_Descriptor descriptorEBUr128 = {
-	MTR_URI "EBUr128",
-	ebur128_instantiate,
-	ebur128_connect_port,
-	NULL,
-	ebur128_run,
-	NULL,
-	ebur128_cleanup,
-	extension_data_ebur
+#define EbuDesc(ID, NAME) \
+static const LV2_Descriptor descriptor ## ID = { \
+	MTR_URI NAME, \
+	ebur128_instantiate, \
+	ebur128_connect_port, \
+	NULL, \
+	ebur128_run, \
+	NULL, \
+	ebur128_cleanup, \
+	extension_data_ebur \
 };
+
+EbuDesc(EBUr128, "EBUr128");
+EbuDesc(EBUr128_5_1, "EBUr128_5_1");
+EbuDesc(EBUr128_7_1, "EBUr128_7_1");
+EbuDesc(EBUr128_7_1_4, "EBUr128_7_1_4");
@@ -19,6 +19,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <pthread.h>
 
 #ifdef HAVE_LV2_1_18_6
 #include <lv2/urid/urid.h>
@@ -144,6 +144,7 @@ goniometer_connect_port(LV2_Handle instance, uint32_t port, void* data)
 static void
 goniometer_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2gm* self = (LV2gm*)instance;
 
 	self->cor->process(self->input[0], self->input[1] , n_samples);
@@ -34,11 +34,25 @@
 #include "../jmeters/msppmdsp.h"
 #include "../jmeters/stcorrdsp.h"
 #include "../jmeters/truepeakdsp.h"
+#include "../jmeters/truepeakmultidsp.h"
 #include "../jmeters/kmeterdsp.h"
+#include "../jmeters/lanemeterdsp.h"
+#include "../jmeters/busmeterdsp.h"
+#include "../jmeters/jmeterkernel.h"
+#include "../jmeters/denormalguard.h"
 #include "../ebumeter/ebu_r128_proc.h"
 
 #include "uris.h"
 #include "uri2.h"
+#include "ebu_history.h"
+
+/* true-peak oversampling of the dBTP and EBU R128 plugins, see Makefile */
+#ifndef TP_FACTOR
+#define TP_FACTOR 4
+#endif
+#if TP_FACTOR != 4 && TP_FACTOR != 8 && TP_FACTOR != 16
+#error TP_FACTOR must be 4, 8 or 16
+#endif
 
 #define FREE_VARPORTS \
 	free (self->mval); \
@@ -87,7 +101,9 @@ typedef struct {
 
 	enum MtrType type;
 
-	JmeterDSP **mtr;
+	void *mtrs; // array of CLASS[chn], see MTRDEF
+	TruePeakMultidsp *tp;
+	Lanemeterdsp *lmtr;
 	Stcorrdsp *cor;
 	Msppmdsp  *bms[2];
 	Ebu_r128_proc *ebu;
@@ -134,6 +150,14 @@ typedef struct {
 	int radar_pos_cur, radar_pos_max;
 	uint32_t radar_spd_cur, radar_spd_max;
 	int radar_resync;
+#ifdef EBU_HISTORY
+	EbuHistoryLog *history;
+	char *history_path;
+	bool history_ui;         // the UI can map the file, no radar resync
+	uint64_t history_rdr;    // history point at the start of the current radar position
+	uint64_t history_spd;    // samples * EBU_HISTORY_RATE
+	float historyMC, historySC, historyTPC;
+#endif
 	uint64_t integration_time;
 	bool send_state_to_ui;
 	uint32_t ui_settings;
@@ -169,24 +193,57 @@ typedef struct {
 } LV2meter;
 
 
+/* The meters of a plugin instance are a single array of the concrete
+ * class. run() and cleanup() are templates on that class (and on the
+ * channel count), so process() and read() are direct, inlinable calls.
+ */
+template <class CLASS>
+static void*
+mtr_new (uint32_t chn, double rate)
+{
+	CLASS* mtr = new CLASS[chn];
+	for (uint32_t c = 0; c < chn; ++c) {
+		mtr[c].init(rate);
+	}
+	return mtr;
+}
+
+/* a single CLASS instance metering all channels */
+template <class CLASS>
+static void*
+mtr_new_multi (uint32_t chn, double rate)
+{
+	CLASS* mtr = new CLASS[1];
+	mtr->init(chn, rate, TP_FACTOR);
+	return mtr;
+}
+
+#define MTRDEF_MULTI(NAME, CLASS, TYPE, KM) \
+	else if (!strcmp(descriptor->URI, MTR_URI NAME "mono")) { \
+		self->chn = 1; \
+		self->kstandard = KM; \
+		self->type = TYPE; \
+		self->mtrs = mtr_new_multi<CLASS> (self->chn, rate); \
+	} \
+	else if (!strcmp(descriptor->URI, MTR_URI NAME "stereo")) { \
+		self->chn = 2; \
+		self->kstandard = KM; \
+		self->type = TYPE; \
+		self->mtrs = mtr_new_multi<CLASS> (self->chn, rate); \
+	}
+
 #define MTRDEF(NAME, CLASS, TYPE, KM) \
 	else if (!strcmp(descriptor->URI, MTR_URI NAME "mono")) { \
 		self->chn = 1; \
 		self->kstandard = KM; \
 		self->type = TYPE; \
-		self->mtr = (JmeterDSP **)malloc (self->chn * sizeof (JmeterDSP *)); \
-		self->mtr[0] = new CLASS(); \
-		static_cast<CLASS *>(self->mtr[0])->init(rate); \
+		self->mtrs = mtr_new<CLASS> (self->chn, rate); \
 	} \
 	else if (!strcmp(descriptor->URI, MTR_URI NAME "stereo")) { \
 		self->chn = 2; \
 		self->kstandard = KM; \
 		self->type = TYPE; \
-		self->mtr = (JmeterDSP **)malloc (self->chn * sizeof (JmeterDSP *)); \
-		self->mtr[0] = new CLASS(); \
-		self->mtr[1] = new CLASS(); \
-		static_cast<CLASS *>(self->mtr[0])->init(rate); \
-		static_cast<CLASS *>(self->mtr[1])->init(rate); \
+		self->mtrs = mtr_new<CLASS> (self->chn, rate); \
 	}
 
 static LV2_Handle
@@ -211,13 +268,14 @@ instantiate(const LV2_Descriptor*     descriptor,
 		self->bms[0] = new Msppmdsp(-6);
 		self->bms[1] = new Msppmdsp(-6);
 		self->bms[0]->init(rate);
+		self->bms[1]->init(rate);
 	}
 	MTRDEF("VU",   Vumeterdsp,  MT_VU,   0)
 	MTRDEF("BBC",  Iec2ppmdsp,  MT_BBC,  0)
 	MTRDEF("EBU",  Iec2ppmdsp,  MT_EBU,  0)
 	MTRDEF("DIN",  Iec1ppmdsp,  MT_DIN,  0)
 	MTRDEF("NOR",  Iec1ppmdsp,  MT_NOR,  0)
-	MTRDEF("dBTP", TruePeakdsp, MT_NONE, 0)
+	MTRDEF_MULTI("dBTP", TruePeakMultidsp, MT_NONE, 0)
 	MTRDEF("K12",  Kmeterdsp,   MT_NONE, 12)
 	MTRDEF("K14",  Kmeterdsp,   MT_NONE, 14)
 	MTRDEF("K20",  Kmeterdsp,   MT_NONE, 20)
@@ -295,32 +353,35 @@ connect_port(LV2_Handle instance,
 	}
 }
 
+template <class CLASS, uint32_t CHN>
 static void
 run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
+	CLASS* const mtr = static_cast<CLASS*>(self->mtrs);
 
 	if (self->p_refl != *self->reflvl) {
 		self->p_refl = *self->reflvl;
 		self->rlgain = powf (10.0f, 0.05f * (self->p_refl + 18.0));
 	}
 
-	for (uint32_t c = 0; c < self->chn; ++c) {
+	for (uint32_t c = 0; c < CHN; ++c) {
 
 		float* const input  = self->input[c];
 		float* const output = self->output[c];
 
-		self->mtr[c]->process(input, n_samples);
+		if (input != output) {
+			mtr[c].CLASS::process(input, output, n_samples);
+		} else {
+			mtr[c].CLASS::process(input, n_samples);
+		}
 
-		self->mval[c] = *self->level[c] = self->rlgain * self->mtr[c]->read();
+		self->mval[c] = *self->level[c] = self->rlgain * mtr[c].CLASS::read();
 		if (self->mval[c] != self->mprev[c]) {
 			self->need_expose = true;
 			self->mprev[c] = self->mval[c];
 		}
-
-		if (input != output) {
-			memcpy(output, input, sizeof(float) * n_samples);
-		}
 	}
 #ifdef DISPLAY_INTERFACE
 	if (self->need_expose && self->queue_draw) {
@@ -330,10 +391,13 @@ run(LV2_Handle instance, uint32_t n_samples)
 #endif
 }
 
+template <uint32_t CHN>
 static void
 kmeter_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
+	Kmeterdsp* const mtr = static_cast<Kmeterdsp*>(self->mtrs);
 	bool reinit_gui = false;
 
 	/* re-use port 0 to request/notify UI about
@@ -344,8 +408,8 @@ kmeter_run(LV2_Handle instance, uint32_t n_samples)
 		if (fabsf(*self->reflvl) < 3) {
 			self->peak_hold = 0;
 			reinit_gui = true;
-			for (uint32_t c = 0; c < self->chn; ++c) {
-				self->mtr[c]->reset();
+			for (uint32_t c = 0; c < CHN; ++c) {
+				mtr[c].reset();
 			}
 		}
 		/* re-notify UI, until UI acknowledges */
@@ -356,43 +420,43 @@ kmeter_run(LV2_Handle instance, uint32_t n_samples)
 		}
 	}
 
-	for (uint32_t c = 0; c < self->chn; ++c) {
+	for (uint32_t c = 0; c < CHN; ++c) {
 
 		float* const input  = self->input[c];
 		float* const output = self->output[c];
 
-		self->mtr[c]->process(input, n_samples);
-
 		if (input != output) {
-			memcpy(output, input, sizeof(float) * n_samples);
+			mtr[c].process(input, output, n_samples);
+		} else {
+			mtr[c].process(input, n_samples);
 		}
 	}
 
 	if (reinit_gui) {
 		/* force parameter change */
-		if (self->chn == 1) {
+		if (CHN == 1) {
 			*self->output[1] = -1 - (rand() & 0xffff); // portindex 5
-		} else if (self->chn == 2) {
+		} else if (CHN == 2) {
 			*self->hold = -1 - (rand() & 0xffff);
 		}
 		return;
 	}
 
-	if (self->chn == 1) {
+	if (CHN == 1) {
 		float m, p;
-		static_cast<Kmeterdsp*>(self->mtr[0])->read(m, p);
+		mtr[0].read(m, p);
 		*self->level[0] = self->rlgain * m;
 		*self->input[1] = self->rlgain * p; // portindex 4
 		if (*self->input[1] > self->peak_hold) self->peak_hold = *self->input[1];
 		*self->output[1] = self->peak_hold; // portindex 5
-	} else if (self->chn == 2) {
+	} else if (CHN == 2) {
 		float m, p;
-		static_cast<Kmeterdsp*>(self->mtr[0])->read(m, p);
+		mtr[0].read(m, p);
 		*self->level[0] = self->rlgain * m;
 		*self->peak[0] = self->rlgain * p;
 		if (*self->peak[0] > self->peak_hold) self->peak_hold = *self->peak[0];
 
-		static_cast<Kmeterdsp*>(self->mtr[1])->read(m, p);
+		mtr[1].read(m, p);
 		*self->level[1] = self->rlgain * m;
 		*self->peak[1] = self->rlgain * p;
 		if (*self->peak[1] > self->peak_hold) self->peak_hold = *self->peak[1];
@@ -401,7 +465,7 @@ kmeter_run(LV2_Handle instance, uint32_t n_samples)
 	}
 
 #ifdef DISPLAY_INTERFACE
-	for (uint32_t c = 0; c < self->chn; ++c) {
+	for (uint32_t c = 0; c < CHN; ++c) {
 		self->mval[c] = *self->level[c];
 		// TODO: IFF difference >= 1/2 px at given self->w
 		if (self->mval[c] != self->mprev[c]) {
@@ -418,27 +482,28 @@ kmeter_run(LV2_Handle instance, uint32_t n_samples)
 }
 
 
+template <class CLASS>
 static void
 cleanup(LV2_Handle instance)
 {
 	LV2meter* self = (LV2meter*)instance;
-	for (uint32_t c = 0; c < self->chn; ++c) {
-		delete self->mtr[c];
-	}
+	delete [] static_cast<CLASS*>(self->mtrs);
 	FREE_VARPORTS;
 #ifdef DISPLAY_INTERFACE
 	if (self->display) cairo_surface_destroy(self->display);
 	if (self->face) cairo_surface_destroy(self->face);
 	if (self->mpat) cairo_pattern_destroy(self->mpat);
 #endif
-	free (self->mtr);
 	free(instance);
 }
 
+template <uint32_t CHN>
 static void
 dbtp_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
+	TruePeakMultidsp* const mtr = static_cast<TruePeakMultidsp*>(self->mtrs);
 	bool reinit_gui = false;
 
 	/* re-use port 0 to request/notify UI about
@@ -449,9 +514,7 @@ dbtp_run(LV2_Handle instance, uint32_t n_samples)
 			reinit_gui = true;
 			self->peak_max[0] = 0;
 			self->peak_max[1] = 0;
-			for (uint32_t c = 0; c < self->chn; ++c) {
-				self->mtr[c]->reset();
-			}
+			mtr->reset();
 		}
 		/* re-notify UI, until UI acknowledges */
 		if (fabsf(*self->reflvl) != 3) {
@@ -462,24 +525,25 @@ dbtp_run(LV2_Handle instance, uint32_t n_samples)
 		reinit_gui = true;
 	}
 
-	for (uint32_t c = 0; c < self->chn; ++c) {
-
-		float* const input  = self->input[c];
-		float* const output = self->output[c];
-
-		self->mtr[c]->process(input, n_samples);
-
-		if (input != output) {
-			memcpy(output, input, sizeof(float) * n_samples);
+	bool inplace = true;
+	for (uint32_t c = 0; c < CHN; ++c) {
+		if (self->input[c] != self->output[c]) {
+			inplace = false;
 		}
 	}
 
+	if (inplace) {
+		mtr->process(self->input, n_samples);
+	} else {
+		mtr->process(self->input, self->output, n_samples);
+	}
+
 	if (reinit_gui) {
 		/* force parameter change */
-		if (self->chn == 1) {
+		if (CHN == 1) {
 			*self->level[0] = -500 - (rand() & 0xffff);
 			*self->input[1] = -500 - (rand() & 0xffff); // portindex 4
-		} else if (self->chn == 2) {
+		} else if (CHN == 2) {
 			*self->level[0] = -500 - (rand() & 0xffff);
 			*self->level[1] = -500 - (rand() & 0xffff);
 			*self->peak[0] = -500 - (rand() & 0xffff);
@@ -488,19 +552,19 @@ dbtp_run(LV2_Handle instance, uint32_t n_samples)
 		return;
 	}
 
-	if (self->chn == 1) {
+	if (CHN == 1) {
 		float m, p;
-		static_cast<TruePeakdsp*>(self->mtr[0])->read(m, p);
+		mtr->read(0, m, p);
 		if (self->peak_max[0] < self->rlgain * p) { self->peak_max[0] = self->rlgain * p; }
 		*self->level[0] = self->rlgain * m;
 		*self->input[1] = self->peak_max[0]; // portindex 4
-	} else if (self->chn == 2) {
+	} else if (CHN == 2) {
 		float m, p;
-		static_cast<TruePeakdsp*>(self->mtr[0])->read(m, p);
+		mtr->read(0, m, p);
 		if (self->peak_max[0] < self->rlgain * p) { self->peak_max[0] = self->rlgain * p; }
 		*self->level[0] = self->rlgain * m;
 		*self->peak[0] = self->peak_max[0];
-		static_cast<TruePeakdsp*>(self->mtr[1])->read(m, p);
+		mtr->read(1, m, p);
 		if (self->peak_max[1] < self->rlgain * p) { self->peak_max[1] = self->rlgain * p; }
 		*self->level[1] = self->rlgain * m;
 		*self->peak[1] = self->peak_max[1];
@@ -511,22 +575,20 @@ dbtp_run(LV2_Handle instance, uint32_t n_samples)
 static void
 cor_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 
-	self->cor->process(self->input[0], self->input[1] , n_samples);
+	if (self->input[0] != self->output[0] || self->input[1] != self->output[1]) {
+		self->cor->process(self->input[0], self->input[1], n_samples, self->output[0], self->output[1]);
+	} else {
+		self->cor->process(self->input[0], self->input[1], n_samples);
+	}
 	self->mval[0] = *self->level[0] = self->cor->read();
 
 	if (self->mval[0] != self->mprev[0]) {
 		self->need_expose = true;
 		self->mprev[0] = self->mval[0];
 	}
-
-	if (self->input[0] != self->output[0]) {
-		memcpy(self->output[0], self->input[0], sizeof(float) * n_samples);
-	}
-	if (self->input[1] != self->output[1]) {
-		memcpy(self->output[1], self->input[1], sizeof(float) * n_samples);
-	}
 #ifdef DISPLAY_INTERFACE
 	if (self->need_expose && self->queue_draw) {
 		self->need_expose = false;
@@ -552,6 +614,7 @@ cor_cleanup(LV2_Handle instance)
 static void
 bbcm_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 
 	if (self->p_refl != *self->reflvl) {
@@ -565,7 +628,12 @@ bbcm_run(LV2_Handle instance, uint32_t n_samples)
 	self->bms[0]->processM(self->input[0], self->input[1], n_samples);
 	self->mval[0] = *self->level[0] = self->rlgain * self->bms[0]->read();
 
-	self->bms[1]->processS(self->input[0], self->input[1], n_samples);
+	/* the side pass also copies input to output, unless in-place */
+	if (self->input[0] != self->output[0] || self->input[1] != self->output[1]) {
+		self->bms[1]->processS(self->input[0], self->input[1], n_samples, self->output[0], self->output[1]);
+	} else {
+		self->bms[1]->processS(self->input[0], self->input[1], n_samples);
+	}
 	self->mval[1] = *self->level[1] = self->rlgain * self->bms[1]->read();
 
 	if (self->mval[0] != self->mprev[0] || self->mval[1] != self->mprev[1]) {
@@ -573,13 +641,6 @@ bbcm_run(LV2_Handle instance, uint32_t n_samples)
 		self->mprev[0] = self->mval[1];
 		self->mprev[0] = self->mval[1];
 	}
-
-	if (self->input[0] != self->output[0]) {
-		memcpy(self->output[0], self->input[0], sizeof(float) * n_samples);
-	}
-	if (self->input[1] != self->output[1]) {
-		memcpy(self->output[1], self->input[1], sizeof(float) * n_samples);
-	}
 #ifdef DISPLAY_INTERFACE
 	if (self->need_expose && self->queue_draw) {
 		self->need_expose = false;
@@ -679,8 +740,12 @@ extension_data_kmeter(const char* uri)
 #include "sigdistlv2.c"
 #include "bitmeter.c"
 #include "surmeter.c"
+#include "busmeter.c"
 
-#define mkdesc(ID, NAME, RUN, EXT) \
+/* RUN and CLEANUP are template-ids, which must be
+ * parenthesized: (run<Vumeterdsp, 1>)
+ */
+#define mkdesc(ID, NAME, RUN, CLEANUP, EXT) \
 static const LV2_Descriptor descriptor ## ID = { \
 	MTR_URI NAME, \
 	instantiate, \
@@ -688,30 +753,30 @@ static const LV2_Descriptor descriptor ## ID = { \
 	NULL, \
 	RUN, \
 	NULL, \
-	cleanup, \
+	CLEANUP, \
 	EXT \
 };
 
-mkdesc(0, "VUmono",   run, extension_data_needle)
-mkdesc(1, "VUstereo", run, extension_data_needle)
-mkdesc(2, "BBCmono",  run, extension_data_needle)
-mkdesc(3, "BBCstereo",run, extension_data_needle)
-mkdesc(4, "EBUmono",  run, extension_data_needle)
-mkdesc(5, "EBUstereo",run, extension_data_needle)
-mkdesc(6, "DINmono",  run, extension_data_needle)
-mkdesc(7, "DINstereo",run, extension_data_needle)
-mkdesc(8, "NORmono",  run, extension_data_needle)
-mkdesc(9, "NORstereo",run, extension_data_needle)
-
-mkdesc(14,"dBTPmono",   dbtp_run, extension_data)
-mkdesc(15,"dBTPstereo", dbtp_run, extension_data)
-
-mkdesc(K12M,"K12mono", kmeter_run, extension_data_kmeter)
-mkdesc(K14M,"K14mono", kmeter_run, extension_data_kmeter)
-mkdesc(K20M,"K20mono", kmeter_run, extension_data_kmeter)
-mkdesc(K12S,"K12stereo", kmeter_run, extension_data_kmeter)
-mkdesc(K14S,"K14stereo", kmeter_run, extension_data_kmeter)
-mkdesc(K20S,"K20stereo", kmeter_run, extension_data_kmeter)
+mkdesc(0, "VUmono",   (run<Vumeterdsp, 1>), (cleanup<Vumeterdsp>), extension_data_needle)
+mkdesc(1, "VUstereo", (run<Vumeterdsp, 2>), (cleanup<Vumeterdsp>), extension_data_needle)
+mkdesc(2, "BBCmono",  (run<Iec2ppmdsp, 1>), (cleanup<Iec2ppmdsp>), extension_data_needle)
+mkdesc(3, "BBCstereo",(run<Iec2ppmdsp, 2>), (cleanup<Iec2ppmdsp>), extension_data_needle)
+mkdesc(4, "EBUmono",  (run<Iec2ppmdsp, 1>), (cleanup<Iec2ppmdsp>), extension_data_needle)
+mkdesc(5, "EBUstereo",(run<Iec2ppmdsp, 2>), (cleanup<Iec2ppmdsp>), extension_data_needle)
+mkdesc(6, "DINmono",  (run<Iec1ppmdsp, 1>), (cleanup<Iec1ppmdsp>), extension_data_needle)
+mkdesc(7, "DINstereo",(run<Iec1ppmdsp, 2>), (cleanup<Iec1ppmdsp>), extension_data_needle)
+mkdesc(8, "NORmono",  (run<Iec1ppmdsp, 1>), (cleanup<Iec1ppmdsp>), extension_data_needle)
+mkdesc(9, "NORstereo",(run<Iec1ppmdsp, 2>), (cleanup<Iec1ppmdsp>), extension_data_needle)
+
+mkdesc(14,"dBTPmono",   (dbtp_run<1>), (cleanup<TruePeakMultidsp>), extension_data)
+mkdesc(15,"dBTPstereo", (dbtp_run<2>), (cleanup<TruePeakMultidsp>), extension_data)
+
+mkdesc(K12M,"K12mono",   (kmeter_run<1>), (cleanup<Kmeterdsp>), extension_data_kmeter)
+mkdesc(K14M,"K14mono",   (kmeter_run<1>), (cleanup<Kmeterdsp>), extension_data_kmeter)
+mkdesc(K20M,"K20mono",   (kmeter_run<1>), (cleanup<Kmeterdsp>), extension_data_kmeter)
+mkdesc(K12S,"K12stereo", (kmeter_run<2>), (cleanup<Kmeterdsp>), extension_data_kmeter)
+mkdesc(K14S,"K14stereo", (kmeter_run<2>), (cleanup<Kmeterdsp>), extension_data_kmeter)
+mkdesc(K20S,"K20stereo", (kmeter_run<2>), (cleanup<Kmeterdsp>), extension_data_kmeter)
 
 static const LV2_Descriptor descriptorCor = {
 	MTR_URI "COR",
@@ -787,6 +852,10 @@ lv2_descriptor(uint32_t index)
 	case 35: return &descriptorSUR5;
 	case 36: return &descriptorSUR4;
 	case 37: return &descriptorSUR3;
+	case 38: return &descriptorBUS;
+	case 39: return &descriptorEBUr128_5_1;
+	case 40: return &descriptorEBUr128_7_1;
+	case 41: return &descriptorEBUr128_7_1_4;
 	default: return NULL;
 	}
 }
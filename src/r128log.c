@@ -0,0 +1,163 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* x42-r128log -- export the loudness history of the EBU R128 meter
+ *
+ * Maps the log written by the plugin read-only and prints it as CSV,
+ * see src/ebu_history.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "ebu_history.h"
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+
+static void
+print_value (int16_t v)
+{
+	if (v == EBU_HISTORY_NONE) {
+		printf (",");
+	} else {
+		printf (",%.2f", ebu_history_dec (v));
+	}
+}
+
+/* print points [n, end), skip those that the plugin overwrote meanwhile */
+static uint64_t
+print_points (const EbuHistory* h, uint64_t n, uint64_t end)
+{
+	uint64_t first;
+	for (; n < end; ++n) {
+		const EbuHistoryPoint p = *ebu_history_point (h, n);
+		if (ebu_history_range (h, &first) >= n + h->size) {
+			continue;
+		}
+		printf ("%.1f", n / (double) h->rate);
+		print_value (p.m);
+		print_value (p.s);
+		print_value (p.tp);
+		printf ("\n");
+	}
+	return n;
+}
+
+static void
+usage (int status)
+{
+	printf ("x42-r128log - EBU R128 Loudness History Export.\n\n");
+	printf ("Usage: x42-r128log [ OPTIONS ] <file>\n\n");
+	printf ("Options:\n"
+	        "  -a, --all                  include points before the last meter reset\n"
+	        "  -f, --follow               keep printing points as they are written\n"
+	        "  -h, --help                 display this help and exit\n"
+	        "  -V, --version              print version information and exit\n"
+	        "\n");
+	printf ("If the environment variable X42_EBUR128_HISTORY names a directory,\n"
+	        "the x42 EBU R128 meter writes its momentary, short-term loudness and\n"
+	        "true-peak every 100ms to a log file there, that covers the last 24\n"
+	        "hours (5MB). The file is kept when the plugin is removed.\n"
+	        "\n"
+	        "This tool prints the log as CSV: time in seconds since the log was\n"
+	        "created, max. momentary and short-term loudness in LUFS and true-peak\n"
+	        "in dBTP during the preceding 100ms; empty if there is no value.\n"
+	        "True-peak is only logged while it is enabled in the meter.\n"
+	        "\n");
+	printf ("Report bugs to <https://github.com/x42/meters.lv2/issues>\n"
+	        "Website: <https://github.com/x42/meters.lv2/>\n");
+	exit (status);
+}
+
+int
+main (int argc, char** argv)
+{
+	bool all    = false;
+	bool follow = false;
+	int  c;
+
+	const struct option long_options[] = {
+		{ "all",     no_argument, 0, 'a' },
+		{ "follow",  no_argument, 0, 'f' },
+		{ "help",    no_argument, 0, 'h' },
+		{ "version", no_argument, 0, 'V' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((c = getopt_long (argc, argv, "afhV", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'a':
+				all = true;
+				break;
+			case 'f':
+				follow = true;
+				break;
+			case 'h':
+				usage (EXIT_SUCCESS);
+				break;
+			case 'V':
+				printf ("x42-r128log version %s\n\n", VERSION);
+				printf ("Copyright (C) GPL 2016 Robin Gareus <robin@gareus.org>\n");
+				return EXIT_SUCCESS;
+			default:
+				usage (EXIT_FAILURE);
+				break;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		usage (EXIT_FAILURE);
+	}
+
+	EbuHistory* h = ebu_history_open (argv[optind]);
+	if (!h) {
+		fprintf (stderr, "Error: '%s' is not a loudness log.\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	const time_t created = h->created;
+	char date[64];
+	strftime (date, sizeof (date), "%Y-%m-%d %H:%M:%S", localtime (&created));
+	printf ("# created %s\n", date);
+	printf ("time,momentary,shortterm,truepeak\n");
+
+	uint64_t first;
+	uint64_t end = ebu_history_range (h, &first);
+	if (all) {
+		first = end > h->size ? end - h->size : 0;
+	}
+	uint64_t n = print_points (h, first, end);
+
+	while (follow) {
+		fflush (stdout);
+		usleep (1000000 / h->rate);
+		end = ebu_history_range (h, &first);
+		if (first > n) {
+			/* meter reset */
+			n = first;
+		}
+		n = print_points (h, n, end);
+	}
+
+	ebu_history_close (h);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,645 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* x42-r128scan -- offline EBU R128 / ITU-R BS.1770 file analyzer
+ *
+ * Measures WAV files as fast as they can be read, one file per
+ * worker thread, and prints integrated loudness, loudness range,
+ * max momentary/short-term loudness and true-peak as JSON.
+ *
+ * With -s long files are split into segments that are measured in
+ * parallel. Each segment is preceded by a warm-up that fills the
+ * filters and loudness windows, the segments' histograms are then
+ * merged and gated once, see Ebu_r128_proc::integr_merge().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../jmeters/truepeakmultidsp.h"
+#include "../jmeters/denormalguard.h"
+#include "../ebumeter/ebu_r128_proc.h"
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+
+using namespace LV2M;
+
+#define SCAN_BLOCK 8192   // frames per read, rounded to whole fragments
+#define SCAN_WARMUP 3.5   // seconds before a segment: S window and filter settling
+
+/******************************************************************************
+ * WAV reader: RIFF and RF64, PCM 8/16/24/32 bit and IEEE float 32/64
+ * bit, plain or WAVE_FORMAT_EXTENSIBLE.
+ */
+
+typedef struct {
+	FILE*    f;
+	int      nchan;
+	int      rate;
+	int      bits;
+	bool     fp;
+	int      align;   // bytes per frame
+	off_t    data;    // file offset of the first frame
+	uint64_t frames;
+} WavFile;
+
+static uint32_t le16 (const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t le32 (const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint64_t le64 (const uint8_t* p) { return le32 (p) | ((uint64_t)le32 (p + 4) << 32); }
+
+static const char*
+wav_open (WavFile* w, const char* fn)
+{
+	uint8_t  h[40];
+	uint64_t ds64 = 0;
+	bool     rf64;
+	bool     have_fmt = false;
+
+	memset (w, 0, sizeof (WavFile));
+	if (!(w->f = fopen (fn, "rb"))) {
+		return "cannot open file";
+	}
+	if (fread (h, 1, 12, w->f) != 12 || memcmp (h + 8, "WAVE", 4)) {
+		return "not a WAV file";
+	}
+	if (!memcmp (h, "RF64", 4)) {
+		rf64 = true;
+	} else if (!memcmp (h, "RIFF", 4)) {
+		rf64 = false;
+	} else {
+		return "not a WAV file";
+	}
+
+	while (fread (h, 1, 8, w->f) == 8) {
+		uint64_t len = le32 (h + 4);
+		if (!memcmp (h, "ds64", 4) && rf64 && len >= 24) {
+			if (fread (h + 8, 1, 24, w->f) != 24) break;
+			ds64 = le64 (h + 16);
+			len -= 24;
+		}
+		else if (!memcmp (h, "fmt ", 4) && len >= 16) {
+			if (fread (h + 8, 1, 16, w->f) != 16) break;
+			uint32_t fmt = le16 (h + 8);
+			w->nchan = le16 (h + 10);
+			w->rate  = le32 (h + 12);
+			w->align = le16 (h + 20);
+			w->bits  = le16 (h + 22);
+			len -= 16;
+			if (fmt == 0xfffe && len >= 10) {
+				/* WAVE_FORMAT_EXTENSIBLE, the sub-format GUID starts with the format tag */
+				if (fread (h, 1, 10, w->f) != 10) break;
+				fmt = le16 (h + 8);
+				len -= 10;
+			}
+			if (fmt == 1) {
+				w->fp = false;
+				if (w->bits != 8 && w->bits != 16 && w->bits != 24 && w->bits != 32) {
+					return "unsupported PCM bit depth";
+				}
+			} else if (fmt == 3) {
+				w->fp = true;
+				if (w->bits != 32 && w->bits != 64) {
+					return "unsupported float bit depth";
+				}
+			} else {
+				return "unsupported sample format";
+			}
+			if (w->nchan < 1 || w->rate < 1 || w->align != w->nchan * w->bits / 8) {
+				return "invalid format chunk";
+			}
+			have_fmt = true;
+		}
+		else if (!memcmp (h, "data", 4)) {
+			if (!have_fmt) {
+				return "data before format chunk";
+			}
+			if (rf64 && len == 0xffffffff) {
+				len = ds64;
+			}
+			w->data = ftello (w->f);
+			if (len == 0 || len == 0xffffffff) {
+				/* written while streaming, the data extends to EOF */
+				if (fseeko (w->f, 0, SEEK_END)) break;
+				len = ftello (w->f) - w->data;
+				if (fseeko (w->f, w->data, SEEK_SET)) break;
+			}
+			w->frames = len / w->align;
+			return NULL;
+		}
+		/* skip the rest of the chunk, chunks are padded to an even size */
+		if (fseeko (w->f, len + (len & 1), SEEK_CUR)) break;
+	}
+	return "no audio data";
+}
+
+static void
+wav_close (WavFile* w)
+{
+	if (w->f) fclose (w->f);
+	w->f = NULL;
+}
+
+static bool
+wav_seek (WavFile* w, uint64_t pos)
+{
+	return 0 == fseeko (w->f, w->data + (off_t)(pos * w->align), SEEK_SET);
+}
+
+/* read up to n frames into planar float buffers, returns frames read */
+static int
+wav_read (WavFile* w, uint8_t* raw, float* const* buf, int n)
+{
+	n = fread (raw, w->align, n, w->f);
+
+	const int nchan = w->nchan;
+	const int bps   = w->bits / 8;
+	for (int c = 0; c < nchan; ++c) {
+		const uint8_t* p = raw + c * bps;
+		float* b = buf[c];
+		switch (w->bits + (w->fp ? 1 : 0)) {
+			case 8:
+				for (int i = 0; i < n; ++i, p += w->align) b[i] = (p[0] - 128) / 128.f;
+				break;
+			case 16:
+				for (int i = 0; i < n; ++i, p += w->align) b[i] = (int16_t)le16 (p) / 32768.f;
+				break;
+			case 24:
+				for (int i = 0; i < n; ++i, p += w->align) b[i] = (int32_t)(((uint32_t)p[0] << 8) | (p[1] << 16) | ((uint32_t)p[2] << 24)) / 2147483648.f;
+				break;
+			case 32:
+				for (int i = 0; i < n; ++i, p += w->align) b[i] = (int32_t)le32 (p) / 2147483648.f;
+				break;
+			case 33:
+				for (int i = 0; i < n; ++i, p += w->align) { uint32_t v = le32 (p); float f; memcpy (&f, &v, 4); b[i] = f; }
+				break;
+			case 65:
+				for (int i = 0; i < n; ++i, p += w->align) { uint64_t v = le64 (p); double d; memcpy (&d, &v, 8); b[i] = d; }
+				break;
+		}
+	}
+	return n;
+}
+
+/******************************************************************************
+ * analysis
+ */
+
+typedef struct {
+	const char*    fn;
+	const char*    error;
+	int            nchan;
+	int            rate;
+	uint64_t       frames;  // frames measured
+	int            nseg;    // number of segments
+	int            ndone;   // segments done
+	Ebu_r128_proc* ebu;     // merged result
+	float          tp;
+	bool           done;
+} ScanResult;
+
+typedef struct {
+	ScanResult* r;
+	uint64_t    start;  // first frame
+	uint64_t    end;    // frame after the last one, 0: until EOF
+} ScanTask;
+
+static int tp_factor = 4;
+static int hop_msec  = EBU_HOP;
+
+/* returns non-zero if the hop is not a whole number of samples */
+static int
+init_proc (Ebu_r128_proc* ebu, int nchan, int rate)
+{
+	switch (nchan) {
+		case 6:  ebu->init (Ebu_r128_proc::SURR_5_1, rate); break;
+		case 8:  ebu->init (Ebu_r128_proc::SURR_7_1, rate); break;
+		case 12: ebu->init (Ebu_r128_proc::SURR_7_1_4, rate); break;
+		default: ebu->init (nchan, rate); break;
+	}
+	return ebu->set_hop (hop_msec);
+}
+
+/* measure frames [start, end) with a warm-up before start, so that
+ * the result can be merged with the adjacent segments. The fragment
+ * grid is that of a single pass from frame 0, and every read is a
+ * whole number of fragments, so that the per-fragment power is the
+ * same sum in the same order. */
+static const char*
+analyze (ScanTask* t, Ebu_r128_proc* ebu, float* tp, uint64_t* frames)
+{
+	WavFile     w;
+	const char* err;
+
+	DenormalGuard dg;
+
+	*tp = 0;
+	*frames = 0;
+
+	if ((err = wav_open (&w, t->r->fn))) {
+		wav_close (&w);
+		return err;
+	}
+	if (w.nchan > MAXCH) {
+		wav_close (&w);
+		return "too many channels";
+	}
+
+	if (init_proc (ebu, w.nchan, w.rate)) {
+		wav_close (&w);
+		return "hop is not a whole number of samples";
+	}
+
+	TruePeakMultidsp tpm;
+	tpm.init (w.nchan, w.rate, tp_factor);
+	tpm.lazy (true); // only the maximum is used
+
+	const int fragm = ebu->fragm_size ();
+	const int block = fragm * (SCAN_BLOCK > fragm ? SCAN_BLOCK / fragm : 1);
+
+	uint64_t end = t->end ? t->end : w.frames;
+	uint64_t warm = 0;
+	if (t->start > 0) {
+		warm = ceil (SCAN_WARMUP * w.rate / fragm) * fragm;
+		if (warm > t->start) warm = t->start;
+	}
+	uint64_t pos = t->start - warm;
+
+	uint8_t* raw = (uint8_t*) malloc (block * w.align);
+	float**  buf = (float**) malloc (w.nchan * sizeof (float*));
+	float*   mem = (float*) malloc (w.nchan * block * sizeof (float));
+	for (int c = 0; c < w.nchan; ++c) {
+		buf[c] = mem + c * block;
+	}
+
+	if (!wav_seek (&w, pos)) {
+		err = "seek failed";
+		end = pos;
+	}
+	if (warm == 0) {
+		ebu->integr_start ();
+	}
+
+	while (pos < end) {
+		int n = block;
+		if (pos < t->start && pos + n > t->start) {
+			n = t->start - pos;
+		}
+		if (pos + n > end) {
+			n = end - pos;
+		}
+		if ((n = wav_read (&w, raw, buf, n)) <= 0) {
+			err = "file is truncated";
+			break;
+		}
+		ebu->process (n, buf);
+		tpm.process_max (buf, n);
+		pos += n;
+
+		if (pos == t->start) {
+			/* end of the warm-up, drop the maxima of the filters'
+			 * onset transient, they are not part of this segment */
+			tpm.reset ();
+			ebu->integr_reset ();
+			ebu->integr_start ();
+		} else if (pos > t->start) {
+			for (int c = 0; c < w.nchan; ++c) {
+				const float v = tpm.read (c);
+				if (v > *tp) *tp = v;
+			}
+		}
+	}
+	*frames = pos > t->start ? pos - t->start : 0;
+
+	free (mem);
+	free (buf);
+	free (raw);
+	wav_close (&w);
+	return err;
+}
+
+/******************************************************************************
+ * JSON output
+ */
+
+static void
+print_string (const char* s)
+{
+	putchar ('"');
+	for (; *s; ++s) {
+		const unsigned char c = *s;
+		if (c == '"' || c == '\\') {
+			printf ("\\%c", c);
+		} else if (c < 0x20) {
+			printf ("\\u%04x", c);
+		} else {
+			putchar (c);
+		}
+	}
+	putchar ('"');
+}
+
+/* no value: -200 from Ebu_r128_proc, -inf dBTP of digital silence */
+static void
+print_value (const char* key, float v)
+{
+	if (v <= -200.f || !isfinite (v)) {
+		printf (", \"%s\": null", key);
+	} else {
+		printf (", \"%s\": %.2f", key, v);
+	}
+}
+
+static void
+print_result (const ScanResult* r, bool first)
+{
+	printf ("%s  {\"file\": ", first ? "" : ",\n");
+	print_string (r->fn);
+	if (r->nchan > 0) {
+		printf (", \"channels\": %d, \"samplerate\": %d, \"duration\": %.3f", r->nchan, r->rate, r->frames / (double) r->rate);
+	}
+	if (r->error) {
+		printf (", \"error\": ");
+		print_string (r->error);
+	}
+	if (r->ebu && (!r->error || r->frames > 0)) {
+		const Ebu_r128_proc* ebu = r->ebu;
+		print_value ("integrated", ebu->integrated ());
+		print_value ("range", ebu->integrated () <= -200.f ? -200.f : ebu->range_max () - ebu->range_min ());
+		print_value ("max_momentary", ebu->maxloudn_M ());
+		print_value ("max_shortterm", ebu->maxloudn_S ());
+		print_value ("true_peak", r->tp > 0 ? 20.f * log10f (r->tp) : -INFINITY);
+	}
+	printf ("}");
+	fflush (stdout);
+}
+
+/******************************************************************************
+ * thread pool, one task (file or segment) per worker at a time.
+ * Results are printed in the order of the command line, as soon as
+ * all segments of a file and all earlier files are done.
+ */
+
+typedef struct {
+	ScanResult*     res;
+	ScanTask*       tasks;
+	int             n_files;
+	int             n_tasks;
+	int             next_task;
+	int             next_print;
+	int             n_errors;
+	pthread_mutex_t lock;
+} ScanPool;
+
+static void*
+worker (void* arg)
+{
+	ScanPool* sp = (ScanPool*)arg;
+	for (;;) {
+		pthread_mutex_lock (&sp->lock);
+		const int i = sp->next_task++;
+		pthread_mutex_unlock (&sp->lock);
+		if (i >= sp->n_tasks) {
+			break;
+		}
+
+		ScanTask*      t   = &sp->tasks[i];
+		ScanResult*    r   = t->r;
+		Ebu_r128_proc* ebu = new Ebu_r128_proc ();
+		uint64_t       frames;
+		float          tp;
+		const char*    err = analyze (t, ebu, &tp, &frames);
+
+		pthread_mutex_lock (&sp->lock);
+		if (err && !r->error) {
+			r->error = err;
+		}
+		if (frames > 0 || !err) {
+			if (r->ebu) {
+				r->ebu->integr_merge (*ebu);
+				delete ebu;
+			} else {
+				ebu->integr_update ();
+				r->ebu = ebu;
+			}
+			if (tp > r->tp) r->tp = tp;
+			r->frames += frames;
+		} else {
+			delete ebu;
+		}
+		if (++r->ndone == r->nseg) {
+			r->done = true;
+			if (r->error) {
+				++sp->n_errors;
+			}
+		}
+		while (sp->next_print < sp->n_files && sp->res[sp->next_print].done) {
+			ScanResult* p = &sp->res[sp->next_print];
+			print_result (p, sp->next_print == 0);
+			delete p->ebu;
+			p->ebu = NULL;
+			++sp->next_print;
+		}
+		pthread_mutex_unlock (&sp->lock);
+	}
+	return NULL;
+}
+
+static void
+usage (int status)
+{
+	printf ("x42-r128scan - EBU R128 File Analyzer.\n\n");
+	printf ("Usage: x42-r128scan [ OPTIONS ] <file> [<file>...]\n\n");
+	printf ("Options:\n"
+	        "  -h, --help                 display this help and exit\n"
+	        "  -j, --jobs <num>           number of files analyzed in parallel\n"
+	        "                             (default: number of CPUs)\n"
+	        "  -m, --hop <msec>           interval of the max. momentary and\n"
+	        "                             short-term measurement, 5..100, must\n"
+	        "                             divide 100 (default: %d)\n"
+	        "  -s, --segment <sec>        split files into segments of the given\n"
+	        "                             length that are analyzed in parallel\n"
+	        "                             (default: 0, off)\n"
+	        "  -t, --oversample <4|8|16>  true-peak oversampling factor (default: 4)\n"
+	        "  -V, --version              print version information and exit\n"
+	        "\n", EBU_HOP);
+	printf ("Measures integrated loudness, loudness range (LRA), max. momentary\n"
+	        "and short-term loudness according to EBU R128 / ITU-R BS.1770-4, and\n"
+	        "the true-peak level of WAV (RIFF or RF64) files.\n"
+	        "Results are printed to stdout as a JSON array, one object per file\n"
+	        "in the order given. Loudness values are in LUFS, the range in LU,\n"
+	        "true-peak in dBTP; null if there is no value (silence, too short).\n"
+	        "6, 8 and 12 channel files are measured as 5.1, 7.1 and 7.1.4\n"
+	        "(LFE excluded), 5 channels as L R C Ls Rs.\n"
+	        "A hop other than %d ms must be a whole number of samples, e.g.\n"
+	        "25 ms is not at 44.1 kHz, such files are not analyzed.\n"
+	        "\n"
+	        "Segments are aligned to the 100ms loudness blocks and preceded by\n"
+	        "a %.1f second warm-up, the result is identical to analyzing the file\n"
+	        "in one piece. Segments shorter than 30 seconds are rarely worth it.\n"
+	        "\n", EBU_HOP, SCAN_WARMUP);
+	printf (
+	        "The exit status is 1 if any file could not be analyzed.\n"
+	        "\n");
+	printf ("Report bugs to <https://github.com/x42/meters.lv2/issues>\n"
+	        "Website: <https://github.com/x42/meters.lv2/>\n");
+	exit (status);
+}
+
+int
+main (int argc, char** argv)
+{
+	int    n_jobs  = 0;
+	double seg_sec = 0;
+	int    c;
+
+	const struct option long_options[] = {
+		{ "help",       no_argument,       0, 'h' },
+		{ "jobs",       required_argument, 0, 'j' },
+		{ "hop",        required_argument, 0, 'm' },
+		{ "segment",    required_argument, 0, 's' },
+		{ "oversample", required_argument, 0, 't' },
+		{ "version",    no_argument,       0, 'V' },
+		{ 0, 0, 0, 0 }
+	};
+
+	while ((c = getopt_long (argc, argv, "hj:m:s:t:V", long_options, NULL)) != -1) {
+		switch (c) {
+			case 'h':
+				usage (EXIT_SUCCESS);
+				break;
+			case 'j':
+				n_jobs = atoi (optarg);
+				break;
+			case 'm':
+				hop_msec = atoi (optarg);
+				if (hop_msec < EBU_MINHOP || 100 % hop_msec) {
+					fprintf (stderr, "Error: hop must divide 100 and be at least %d ms.\n", EBU_MINHOP);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				seg_sec = atof (optarg);
+				if (seg_sec < 0) {
+					fprintf (stderr, "Error: segment length must not be negative.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 't':
+				tp_factor = atoi (optarg);
+				if (tp_factor != 4 && tp_factor != 8 && tp_factor != 16) {
+					fprintf (stderr, "Error: oversampling factor must be 4, 8 or 16.\n");
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'V':
+				printf ("x42-r128scan version %s\n\n", VERSION);
+				printf ("Copyright (C) GPL 2016 Robin Gareus <robin@gareus.org>\n");
+				return EXIT_SUCCESS;
+			default:
+				usage (EXIT_FAILURE);
+				break;
+		}
+	}
+
+	if (optind >= argc) {
+		usage (EXIT_FAILURE);
+	}
+
+	ScanPool sp;
+	sp.n_files    = argc - optind;
+	sp.n_tasks    = 0;
+	sp.next_task  = 0;
+	sp.next_print = 0;
+	sp.n_errors   = 0;
+	sp.res        = (ScanResult*) calloc (sp.n_files, sizeof (ScanResult));
+	sp.tasks      = NULL;
+	pthread_mutex_init (&sp.lock, NULL);
+
+	/* read the headers, and split files into segments */
+	int n_alloc = 0;
+	for (int i = 0; i < sp.n_files; ++i) {
+		ScanResult* r = &sp.res[i];
+		WavFile     w;
+		uint64_t    seg = 0;
+
+		r->fn = argv[optind + i];
+		if (!wav_open (&w, r->fn) && w.nchan <= MAXCH) {
+			r->nchan = w.nchan;
+			r->rate  = w.rate;
+			if (seg_sec > 0) {
+				/* segment boundaries on the integration grid (S window hop) */
+				Ebu_r128_proc ebu;
+				if (!init_proc (&ebu, w.nchan, w.rate)) {
+					const int grid = ebu.integr_period ();
+					seg = grid * (uint64_t) ceil (seg_sec * w.rate / grid);
+				}
+			}
+		}
+		r->nseg = (seg > 0 && w.frames > seg) ? (w.frames + seg - 1) / seg : 1;
+		wav_close (&w);
+
+		if (sp.n_tasks + r->nseg > n_alloc) {
+			n_alloc = 2 * n_alloc + r->nseg;
+			sp.tasks = (ScanTask*) realloc (sp.tasks, n_alloc * sizeof (ScanTask));
+		}
+		for (int k = 0; k < r->nseg; ++k) {
+			ScanTask* t = &sp.tasks[sp.n_tasks++];
+			t->r     = r;
+			t->start = k * seg;
+			t->end   = k + 1 < r->nseg ? (k + 1) * seg : 0;
+		}
+	}
+
+	if (n_jobs < 1) {
+		n_jobs = sysconf (_SC_NPROCESSORS_ONLN);
+	}
+	if (n_jobs < 1) {
+		n_jobs = 1;
+	}
+	if (n_jobs > sp.n_tasks) {
+		n_jobs = sp.n_tasks;
+	}
+
+	printf ("[\n");
+	pthread_t* threads = (pthread_t*) malloc (n_jobs * sizeof (pthread_t));
+	int n_threads = 0;
+	for (int i = 1; i < n_jobs; ++i) {
+		if (pthread_create (&threads[n_threads], NULL, worker, &sp)) {
+			break;
+		}
+		++n_threads;
+	}
+	worker (&sp); // the main thread is a worker, too
+	for (int i = 0; i < n_threads; ++i) {
+		pthread_join (threads[i], NULL);
+	}
+	printf ("\n]\n");
+
+	free (threads);
+	free (sp.tasks);
+	free (sp.res);
+	pthread_mutex_destroy (&sp.lock);
+	return sp.n_errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -200,6 +200,7 @@ sdh_connect_port(LV2_Handle instance, uint32_t port, void* data)
 static void
 sdh_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 
 	const uint32_t capacity = self->notify->atom.size;
@@ -51,7 +51,6 @@
 enum filterCoeff {a0 = 0, a1, a2, b0, b1, b2};
 enum filterState {z1 = 0, z2};
 
-#define NODENORMAL (1e-12)
 #define MAXORDER (6)
 
 struct Filter {
@@ -62,7 +61,6 @@ struct Filter {
 struct FilterBank {
 	struct Filter f[MAXORDER];
 	uint32_t filter_stages;
-	bool ac;
 };
 
 static inline double
@@ -75,11 +73,11 @@ proc_one(struct Filter * const f, const double in)
 	return y;
 }
 
+/* denormals are flushed by the caller (DenormalGuard) */
 static inline float
 bandpass_process(struct FilterBank * const fb, const float in)
 {
-	fb->ac = !fb->ac;
-	double out = in + ((fb->ac) ? NODENORMAL : -NODENORMAL);
+	double out = in;
 	for (uint32_t i = 0; i < fb->filter_stages; ++i) {
 		out = proc_one(&fb->f[i], out);
 	}
@@ -159,9 +159,12 @@ spectrum_connect_port(LV2_Handle instance, uint32_t port, void* data)
 static void
 spectrum_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2spec* self = (LV2spec*)instance;
 	float* inL = self->input[0];
 	float* inR = self->input[1];
+	float* outL = self->output[0];
+	float* outR = self->output[1];
 	bool reinit_gui = false;
 
 	/* calculate time-constant when it is changed,
@@ -210,12 +213,16 @@ spectrum_run(LV2_Handle instance, uint32_t n_samples)
 	for (uint32_t j = 0 ; j < n_samples; ++j) {
 		float in;
 		// TODO separate loop implementation for mono+stereo for efficiency
+		// pass-through is written in the same pass (no-op if in-place)
 		if (stereo) {
 			const float L = *(inL++);
 			const float R = *(inR++);
+			*(outL++) = L;
+			*(outR++) = R;
 			in = (L + R) / 2.0f;
 		} else {
 			in = *(inL++);
+			*(outL++) = in;
 		}
 				
 		for(int i = 0; i < FILTER_COUNT; ++i) {
@@ -247,13 +254,6 @@ spectrum_run(LV2_Handle instance, uint32_t n_samples)
 			*(self->maxf[i]) = mx > .00001f ? 20.0 * log10f(mx) : -100.0;
 		}
 	}
-
-	if (self->input[0] != self->output[0]) {
-		memcpy(self->output[0], self->input[0], sizeof(float) * n_samples);
-	}
-	if (self->input[1] != self->output[1]) {
-		memcpy(self->output[1], self->input[1], sizeof(float) * n_samples);
-	}
 }
 
 static void
@@ -49,11 +49,9 @@ sur_instantiate(
 		return NULL;
 	}
 
-	self->mtr = (JmeterDSP **) malloc (self->chn * sizeof (JmeterDSP *));
-	for (uint32_t i = 0; i < self->chn; ++i) {
-		self->mtr[i] = new Kmeterdsp();
-		static_cast<Kmeterdsp *>(self->mtr[i])->init(rate);
-	}
+	/* all channels' K-meter ballistics are processed in parallel */
+	self->lmtr = new Lanemeterdsp();
+	self->lmtr->init (Lanemeterdsp::KMETER, self->chn, rate);
 
 	self->level  = (float**) calloc (self->chn, sizeof (float*));
 	self->input  = (float**) calloc (self->chn, sizeof (float*));
@@ -115,6 +113,7 @@ sur_connect_port (LV2_Handle instance, uint32_t port, void* data)
 static void
 sur_run(LV2_Handle instance, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	LV2meter* self = (LV2meter*)instance;
 	uint32_t cors = self->chn > 3 ? 4 : 3;
 
@@ -127,22 +126,24 @@ sur_run(LV2_Handle instance, uint32_t n_samples)
 		*self->surc_c[c] = self->cor4[c]->read();
 	}
 
+	bool in_place = true;
 	for (uint32_t c = 0; c < self->chn; ++c) {
-		float m, p;
-
-		float* const input  = self->input[c];
-		float* const output = self->output[c];
+		if (self->input[c] != self->output[c]) in_place = false;
+	}
 
-		self->mtr[c]->process(input, n_samples);
+	/* meter, and unless in-place, copy input to output */
+	if (in_place) {
+		self->lmtr->process (self->input, n_samples);
+	} else {
+		self->lmtr->process (self->input, self->output, n_samples);
+	}
 
-		static_cast<Kmeterdsp*>(self->mtr[c])->read(m, p);
+	for (uint32_t c = 0; c < self->chn; ++c) {
+		float m, p;
+		self->lmtr->read (c, m, p);
 
 		*self->level[c] = m;
 		*self->peak[c]  = p;
-
-		if (input != output) {
-			memcpy(output, input, sizeof(float) * n_samples);
-		}
 	}
 }
 
@@ -153,11 +154,8 @@ sur_cleanup(LV2_Handle instance)
 	for (uint32_t c = 0; c < 4; ++c) {
 		delete self->cor4[c];
 	}
-	for (uint32_t c = 0; c < self->chn; ++c) {
-		delete self->mtr[c];
-	}
+	delete self->lmtr;
 	FREE_VARPORTS;
-	free (self->mtr);
 	free(instance);
 }
 
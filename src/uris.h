@@ -80,6 +80,9 @@
 #define MTR__rdr_pointpos     MTR_URI "rdr_pointpos"
 #define MTR__rdr_pos_cur      MTR_URI "rdr_pos_cur"
 #define MTR__rdr_pos_max      MTR_URI "rdr_pos_max"
+#define MTR__rdr_history      MTR_URI "rdr_history"
+#define MTR__rdr_histfile     MTR_URI "rdr_histfile"
+#define MTR__rdr_binlen       MTR_URI "rdr_binlen"
 
 #define MTR__sdh_histogram    MTR_URI "sdh_histogram"
 #define MTR__sdh_hist_max     MTR_URI "sdh_hist_max"
@@ -156,6 +159,9 @@ typedef struct {
 	LV2_URID rdr_pointpos;
 	LV2_URID rdr_pos_cur;
 	LV2_URID rdr_pos_max;
+	LV2_URID rdr_history;
+	LV2_URID rdr_histfile;
+	LV2_URID rdr_binlen;
 
 	LV2_URID sdh_histogram;
 	LV2_URID sdh_hist_max;
@@ -200,6 +206,7 @@ enum {
 	CTL_SAMPLERATE,
 	CTL_WINDOWED,
 	CTL_AVERAGE,
+	CTL_RADARRESYNC,
 };
 
 
@@ -242,6 +249,9 @@ map_eburlv2_uris(LV2_URID_Map* map, EBULV2URIs* uris)
 	uris->rdr_pointpos        = map->map(map->handle, MTR__rdr_pointpos);
 	uris->rdr_pos_cur         = map->map(map->handle, MTR__rdr_pos_cur);
 	uris->rdr_pos_max         = map->map(map->handle, MTR__rdr_pos_max);
+	uris->rdr_history         = map->map(map->handle, MTR__rdr_history);
+	uris->rdr_histfile        = map->map(map->handle, MTR__rdr_histfile);
+	uris->rdr_binlen          = map->map(map->handle, MTR__rdr_binlen);
 
 	uris->sdh_histogram       = map->map(map->handle, MTR__sdh_histogram);
 	uris->sdh_hist_max        = map->map(map->handle, MTR__sdh_hist_max);
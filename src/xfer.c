@@ -182,6 +182,7 @@ static void tx_rawstereo(LV2_Atom_Forge *forge, XferLV2URIs *uris,
 static void
 xfer_run(LV2_Handle handle, uint32_t n_samples)
 {
+	DenormalGuard dg;
 	Xfer* self = (Xfer*)handle;
 	const size_t size = (sizeof(float) * n_samples + 64) * self->n_channels;
 	const uint32_t capacity = self->notify->atom.size;
@@ -245,9 +246,21 @@ xfer_run(LV2_Handle handle, uint32_t n_samples)
 		}
 	}
 
-	if (self->stcor) {
-		self->stcor->process(self->input[0], self->input[1] , n_samples);
+	/* if not processing in-place, forward audio
+	 * (the correlation meter does this in the same pass) */
+	if (self->stcor && (self->input[0] != self->output[0] || self->input[1] != self->output[1])) {
+		self->stcor->process(self->input[0], self->input[1] , n_samples, self->output[0], self->output[1]);
 		*self->p_phase = self->stcor->read();
+	} else {
+		if (self->stcor) {
+			self->stcor->process(self->input[0], self->input[1] , n_samples);
+			*self->p_phase = self->stcor->read();
+		}
+		for (uint32_t c = 0; c < self->n_channels; ++c) {
+			if (self->input[c] != self->output[c]) {
+				jmeter_copy (self->input[c], self->output[c], n_samples);
+			}
+		}
 	}
 
 	/* if UI is active, send raw audio data to GUI */
@@ -264,14 +277,6 @@ xfer_run(LV2_Handle handle, uint32_t n_samples)
 
 	/* close off atom-sequence */
 	lv2_atom_forge_pop(&self->forge, &self->frame);
-
-	/* if not processing in-place, forward audio */
-	for (uint32_t c = 0; c < self->n_channels; ++c) {
-		if (self->input[c] != self->output[c]) {
-			memcpy(self->output[c], self->input[c], sizeof(float) * n_samples);
-		}
-	}
-
 }
 
 static void
@@ -0,0 +1,141 @@
+/* Copyright (C) 2016 Robin Gareus <robin@gareus.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/* Denormal benchmark -- `make bench`
+ *
+ * The filters that used to add bias constants per sample (Stcorrdsp,
+ * the EBU R128 K-filter and the spectrum bandpass) rely on DenormalGuard
+ * instead. This feeds each a burst of noise followed by silence, in
+ * 256 frame periods, and prints the time per sample of the silent part
+ * with and without the guard. Without it, the filter states decay into
+ * the denormal range and the silent part becomes many times slower.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../jmeters/stcorrdsp.h"
+#include "../jmeters/denormalguard.h"
+#include "../ebumeter/ebu_r128_proc.h"
+#include "../src/spectr.c"
+
+using namespace LV2M;
+
+#define RATE    48000
+#define PERIOD  256
+#define BURST   (PERIOD * 94)   // noise, ~0.5s
+#define SILENCE (PERIOD * 3750) // timed, 20s
+#define NBANDS  30
+
+static float noise[2][BURST];
+static float zero[2][PERIOD];
+static volatile float sink; // keeps the results alive
+
+static double
+now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/* runs CLASS over the burst, then times the silence, in ns per frame */
+template <class CLASS>
+static double
+measure (bool guard)
+{
+	CLASS dsp;
+	double t0 = 0;
+
+	for (int off = 0; off < BURST + SILENCE; off += PERIOD) {
+		if (off == BURST) {
+			t0 = now ();
+		}
+		float* p[2];
+		for (int c = 0; c < 2; ++c) {
+			p[c] = off < BURST ? noise[c] + off : zero[c];
+		}
+		if (guard) {
+			DenormalGuard dg;
+			dsp.run (p, PERIOD);
+		} else {
+			dsp.run (p, PERIOD);
+		}
+	}
+	const double t = now () - t0;
+	sink = dsp.value ();
+	return 1e9 * t / SILENCE;
+}
+
+struct Corr {
+	Corr () : _v (0) { _d.init (RATE, 2e3f, 0.3f); }
+	void run (float** p, int n) { _d.process (p[0], p[1], n); _v += _d.read (); }
+	float value () const { return _v; }
+	Stcorrdsp _d;
+	float _v;
+};
+
+struct Ebu {
+	Ebu () { _d.init (2, RATE); _d.integr_start (); }
+	void run (float** p, int n) { _d.process (n, p); }
+	float value () const { return _d.loudness_M (); }
+	Ebu_r128_proc _d;
+};
+
+/* the 1/3 octave filter bank of the spectrum plugin, one channel */
+struct Spectrum {
+	Spectrum () {
+		const double f1f = pow (2, -1. / 6.);
+		const double f2f = pow (2,  1. / 6.);
+		for (int i = 0; i < NBANDS; ++i) {
+			const double f_m = pow (2, (i - 16) / 3.) * 1000;
+			bandpass_setup (&_f[i], RATE, f_m, f_m * (f2f - f1f), 6);
+		}
+		_s = 0;
+	}
+	void run (float** p, int n) {
+		for (int i = 0; i < NBANDS; ++i) {
+			for (int j = 0; j < n; ++j) {
+				const float v = bandpass_process (&_f[i], p[0][j]);
+				_s += v * v;
+			}
+		}
+	}
+	float value () const { return _s; }
+	struct FilterBank _f[NBANDS];
+	float _s;
+};
+
+int
+main (int argc, char** argv)
+{
+	srand (1);
+	for (int c = 0; c < 2; ++c) {
+		for (int i = 0; i < BURST; ++i) {
+			noise[c][i] = rand () / (float) RAND_MAX - .5f;
+		}
+	}
+
+	printf ("silence after a noise burst, %d frame periods, ns/frame\n\n", PERIOD);
+	printf ("                 no guard    guard\n");
+	printf ("  Stcorrdsp      %8.1f %8.1f\n", measure<Corr> (false), measure<Corr> (true));
+	printf ("  EBU R128       %8.1f %8.1f\n", measure<Ebu> (false), measure<Ebu> (true));
+	printf ("  Spectrum (%d)  %8.1f %8.1f\n", NBANDS, measure<Spectrum> (false), measure<Spectrum> (true));
+	return 0;
+}
@@ -46,7 +46,28 @@ static double wind (double x)
 
 
 Resampler_table  *Resampler_table::_list = 0;
-Resampler_mutex   Resampler_table::_mutex;
+
+
+// Frees the cached tables when the library is unloaded.
+
+class Resampler_cache
+{
+public:
+
+    ~Resampler_cache (void)
+    {
+	Resampler_table *P, *Q;
+
+	for (P = Resampler_table::_list; P; P = Q)
+	{
+	    Q = P->_next;
+	    delete P;
+	}
+	Resampler_table::_list = 0;
+    }
+};
+
+static Resampler_cache  resampler_cache;
 
 
 Resampler_table::Resampler_table (double fr, unsigned int hl, unsigned int np) :
@@ -72,67 +93,75 @@ Resampler_table::Resampler_table (double fr, unsigned int hl, unsigned int np) :
 	}
 	p += hl;
     }
+
+    // Full rows, one contiguous dot product per output sample.
+    _ftab = new float [2 * hl * np];
+    p = _ftab;
+    for (j = 0; j < np; j++)
+    {
+	for (i = 0; i < hl; i++)
+	{
+	    p [i] = _ctab [hl * j + i];
+	    p [2 * hl - 1 - i] = _ctab [hl * (np - j) + i];
+	}
+	p += 2 * hl;
+    }
 }
 
 
 Resampler_table::~Resampler_table (void)
 {
     delete[] _ctab;
+    delete[] _ftab;
+}
+
+
+// Search the list from P up to, not including, E.
+
+Resampler_table *Resampler_table::find (Resampler_table *P, Resampler_table *E, double fr, unsigned int hl, unsigned int np)
+{
+    while (P != E)
+    {
+	if ((fr >= P->_fr * 0.999) && (fr <= P->_fr * 1.001) && (hl == P->_hl) && (np == P->_np)) return P;
+	P = __atomic_load_n (&P->_next, __ATOMIC_ACQUIRE);
+    }
+    return 0;
 }
 
 
 Resampler_table *Resampler_table::create (double fr, unsigned int hl, unsigned int np)
 {
-    Resampler_table *P;
+    Resampler_table *H, *P, *T;
 
-    _mutex.lock ();
-    P = _list;
-    while (P)
+    H = __atomic_load_n (&_list, __ATOMIC_ACQUIRE);
+    P = find (H, 0, fr, hl, np);
+    if (P)
     {
-	if ((fr >= P->_fr * 0.999) && (fr <= P->_fr * 1.001) && (hl == P->_hl) && (np == P->_np))
-	{
-	    P->_refc++;
-            _mutex.unlock ();
-            return P;
-	}
-	P = P->_next;
+	__atomic_add_fetch (&P->_refc, 1, __ATOMIC_RELAXED);
+	return P;
     }
-    P = new Resampler_table (fr, hl, np);
-    P->_refc = 1;
-    P->_next = _list;
-    _list = P;
-    _mutex.unlock ();
+
+    // Not cached: compute outside of any lock, then publish at the head.
+    // If another thread added the same table meanwhile, use that one.
+    T = new Resampler_table (fr, hl, np);
+    T->_refc = 1;
+    do
+    {
+	T->_next = H;
+	if (__atomic_compare_exchange_n (&_list, &H, T, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) return T;
+	P = find (H, T->_next, fr, hl, np);
+    }
+    while (!P);
+
+    delete T;
+    __atomic_add_fetch (&P->_refc, 1, __ATOMIC_RELAXED);
     return P;
 }
 
 
 void Resampler_table::destroy (Resampler_table *T)
 {
-    Resampler_table *P, *Q;
-
-    _mutex.lock ();
-    if (T)
-    {
-	T->_refc--;
-	if (T->_refc == 0)
-	{
-	    P = _list;
-	    Q = 0;
-	    while (P)
-	    {
-		if (P == T)
-		{
-		    if (Q) Q->_next = T->_next;
-		    else      _list = T->_next;
-		    break;
-		}
-		Q = P;
-		P = P->_next;
-	    }
-	    delete T;
-	}
-    }
-    _mutex.unlock ();
+    if (T) __atomic_sub_fetch (&T->_refc, 1, __ATOMIC_RELAXED);
 }
 
 
@@ -141,7 +170,7 @@ void Resampler_table::print_list (void)
     Resampler_table *P;
 
     printf ("Resampler table\n----\n");
-    for (P = _list; P; P = P->_next)
+    for (P = __atomic_load_n (&_list, __ATOMIC_ACQUIRE); P; P = P->_next)
     {
 	printf ("refc = %3d   fr = %10.6lf  hl = %4d  np = %4d\n", P->_refc, P->_fr, P->_hl, P->_np);
     }
@@ -22,26 +22,8 @@
 #define __RESAMPLER_TABLE_H
 
 
-#include <pthread.h>
-
-
 namespace LV2M {
 
-class Resampler_mutex
-{
-private:
-
-    friend class Resampler_table;
-
-    Resampler_mutex (void) { pthread_mutex_init (&_mutex, 0); }
-    ~Resampler_mutex (void) { pthread_mutex_destroy (&_mutex); }
-    void lock (void) { pthread_mutex_lock (&_mutex); }
-    void unlock (void) { pthread_mutex_unlock (&_mutex); }
-
-    pthread_mutex_t  _mutex;
-};
-
-
 class Resampler_table
 {
 public:
@@ -55,19 +37,24 @@ private:
 
     friend class Resampler;
     friend class VResampler;
+    friend class Tpoversampler;
+    friend class Resampler_cache;
 
     Resampler_table     *_next;
     unsigned int         _refc;
     float               *_ctab;
+    float               *_ftab;   // [np][2 * hl] both halves of phase j, oldest sample first
     double               _fr;
     unsigned int         _hl;
     unsigned int         _np;
 
     static Resampler_table *create (double fr, unsigned int hl, unsigned int np);
     static void destroy (Resampler_table *T);
+    static Resampler_table *find (Resampler_table *P, Resampler_table *E, double fr, unsigned int hl, unsigned int np);
 
+    // Tables are never unlinked: lookup is a lock-free list walk,
+    // unused tables stay cached until the library is unloaded.
     static Resampler_table  *_list;
-    static Resampler_mutex   _mutex;
 };
 
 };
@@ -23,9 +23,46 @@
 #include <string.h>
 #include <math.h>
 #include "../zita-resampler/resampler.h"
+#include "../jmeters/jmeterkernel.h"
 
 namespace LV2M {
 
+#if defined __AVX__
+typedef LaneAVX RsLane;
+#elif defined __SSE__
+typedef LaneSSE RsLane;
+#else
+typedef LaneFlt RsLane;
+#endif
+
+
+// Dot product of the 2 * hl most recent samples w [] of a channel
+// and a full table row f [], both contiguous. HL = 0 for any hl.
+
+template <class L, int HL>
+static float rs_dot (const float *w, const float *f, unsigned int hl)
+{
+    typedef typename L::V V;
+    const int n = HL ? 2 * HL : 2 * hl;
+    V s0 = L::set1 (0);
+    V s1 = L::set1 (0);
+    int i = 0;
+
+    for (; i + 2 * L::N <= n; i += 2 * L::N)
+    {
+	s0 = L::add (s0, L::mul (L::load (w + i), L::load (f + i)));
+	s1 = L::add (s1, L::mul (L::load (w + i + L::N), L::load (f + i + L::N)));
+    }
+    if (i + L::N <= n)
+    {
+	s0 = L::add (s0, L::mul (L::load (w + i), L::load (f + i)));
+	i += L::N;
+    }
+    float s = 1e-20f + L::sum (L::add (s0, s1));
+    for (; i < n; i++) s += w [i] * f [i];
+    return s - 1e-20f;
+}
+
 static unsigned int gcd (unsigned int a, unsigned int b)
 {
     if (a == 0) return b;
@@ -52,7 +89,9 @@ static unsigned int gcd (unsigned int a, unsigned int b)
 Resampler::Resampler (void) :
     _table (0),
     _nchan (0),
-    _buff  (0)
+    _bsize (0),
+    _buff  (0),
+    _dot   (0)
 {
     reset ();
 }
@@ -111,7 +150,16 @@ int Resampler::setup (unsigned int fs_inp,
     {
 	_table = T;
 	_buff  = B;
+	_bsize = 2 * h - 1 + k;
 	_nchan = nchan;
+	switch (h)
+	{
+	case 16: _dot = rs_dot <RsLane, 16>; break;
+	case 24: _dot = rs_dot <RsLane, 24>; break;
+	case 32: _dot = rs_dot <RsLane, 32>; break;
+	case 48: _dot = rs_dot <RsLane, 48>; break;
+	default: _dot = rs_dot <RsLane, 0>;  break;
+	}
 	_inmax = k;
 	_pstep = s;
 	return reset ();
@@ -127,6 +175,8 @@ void Resampler::clear (void)
     _buff  = 0;
     _table = 0;
     _nchan = 0;
+    _bsize = 0;
+    _dot   = 0;
     _inmax = 0;
     _pstep = 0;
     reset ();
@@ -170,7 +220,7 @@ int Resampler::reset (void)
 
 int Resampler::process (void)
 {
-    unsigned int   hl, ph, np, dp, in, nr, nz, i, n, c;
+    unsigned int   hl, ph, np, dp, in, nr, nz, bs, n, c;
     float          *p1, *p2;
 
     if (!_table) return 1;
@@ -178,12 +228,13 @@ int Resampler::process (void)
     hl = _table->_hl;
     np = _table->_np;
     dp = _pstep;
+    bs = _bsize;
     in = _index;
     nr = _nread;
     ph = _phase;
     nz = _nzero;
-    n = (2 * hl - nr) * _nchan;
-    p1 = _buff + in * _nchan;
+    n = 2 * hl - nr;
+    p1 = _buff + in;
     p2 = p1 + n;
 
     while (out_count)
@@ -193,17 +244,17 @@ int Resampler::process (void)
 	    if (inp_count == 0) break;
   	    if (inp_data)
 	    {
-                for (c = 0; c < _nchan; c++) p2 [c] = inp_data [c];
+                for (c = 0; c < _nchan; c++) p2 [c * bs] = inp_data [c];
 		inp_data += _nchan;
 		nz = 0;
 	    }
 	    else
 	    {
-                for (c = 0; c < _nchan; c++) p2 [c] = 0;
+                for (c = 0; c < _nchan; c++) p2 [c * bs] = 0;
 		if (nz < 2 * hl) nz++;
 	    }
 	    nr--;
-	    p2 += _nchan;
+	    p2++;
 	    inp_count--;
 	}
 	else
@@ -212,20 +263,10 @@ int Resampler::process (void)
 	    {
 		if (nz < 2 * hl)
 		{
-		    float *c1 = _table->_ctab + hl * ph;
-		    float *c2 = _table->_ctab + hl * (np - ph);
+		    const float *f = _table->_ftab + 2 * hl * ph;
 		    for (c = 0; c < _nchan; c++)
 		    {
-			float *q1 = p1 + c;
-			float *q2 = p2 + c;
-			float s = 1e-20f;
-			for (i = 0; i < hl; i++)
-			{
-			    q2 -= _nchan;
-			    s += *q1 * c1 [i] + *q2 * c2 [i];
-			    q1 += _nchan;
-			}
-			*out_data++ = s - 1e-20f;
+			*out_data++ = _dot (p1 + c * bs, f, hl);
 		    }
 		}
 		else
@@ -241,11 +282,14 @@ int Resampler::process (void)
 		nr = ph / np;
 		ph -= nr * np;
 		in += nr;
-		p1 += nr * _nchan;;
+		p1 += nr;
 		if (in >= _inmax)
 		{
-		    n = (2 * hl - nr) * _nchan;
-		    memcpy (_buff, p1, n * sizeof (float));
+		    n = 2 * hl - nr;
+		    for (c = 0; c < _nchan; c++)
+		    {
+			memcpy (_buff + c * bs, p1 + c * bs, n * sizeof (float));
+		    }
 		    in = 0;
 		    p1 = _buff;
 		    p2 = p1 + n;
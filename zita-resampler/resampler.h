@@ -70,7 +70,9 @@ private:
     unsigned int         _nzero;
     unsigned int         _phase;
     unsigned int         _pstep;
-    float               *_buff;
+    unsigned int         _bsize;   // per channel history size
+    float               *_buff;    // planar, channel c at _buff + c * _bsize
+    float             (*_dot) (const float *, const float *, unsigned int);
     void                *_dummy [8];
 };
 